@@ -1,3 +1,4 @@
+#include "allocation_counter.h"
 #include "document.h"
 #include "string_processing.h"
 #include "search_server.h"
@@ -7,11 +8,27 @@
 //#include "funck_to_check.h"
 #include "remove_duplicates.h"
 #include "process_queries.h"
+#include "concurrent_map.h"
+#include "concurrent_hash_map.h"
+#include "sharded_search_server.h"
+#include "query_client.h"
+#include "query_service.h"
+#include "snapshot_search_server.h"
+#include "versioned_search_server.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <execution>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <random>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace std;
 
@@ -58,6 +75,12 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
     return queries;
 }
 
+bool HaveSameDocuments(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return lhs.size() == rhs.size() && equal(lhs.begin(), lhs.end(), rhs.begin(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+        });
+}
+
 template <typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
@@ -72,7 +95,889 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
 
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 
-int main() {
+void BenchmarkBroadQueries(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 100, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 50'000, 50);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    const auto queries = GenerateQueries(generator, dictionary, 100, 10);
+
+    cout << "Broad queries, hardware threads: "s << thread::hardware_concurrency() << endl;
+    TEST(seq);
+    TEST(par);
+}
+
+void BenchmarkBulkIndexing(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto texts = GenerateQueries(generator, dictionary, 100'000, 70);
+
+    cout << "Indexing, hardware threads: "s << thread::hardware_concurrency() << endl;
+    SearchServer one_by_one(dictionary[0]);
+    {
+        LOG_DURATION("AddDocument"sv);
+        for (size_t i = 0; i < texts.size(); ++i) {
+            one_by_one.AddDocument(i, texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+    }
+
+    vector<NewDocument> documents;
+    documents.reserve(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        documents.push_back({ static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 } });
+    }
+    SearchServer bulk(dictionary[0]);
+    {
+        LOG_DURATION("AddDocuments"sv);
+        bulk.AddDocuments(documents);
+    }
+    cout << one_by_one.GetDocumentCount() << " "s << bulk.GetDocumentCount() << endl;
+}
+
+void BenchmarkRemoveDocuments(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 50'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    const auto find_all = [&](string_view mark) {
+        LOG_DURATION(mark);
+        size_t found = 0;
+        for (const string_view query : queries) {
+            found += search_server.FindTopDocuments(query).size();
+        }
+        cout << found << endl;
+    };
+
+    {
+        LOG_DURATION("RemoveDocument"sv);
+        for (size_t i = 0; i < documents.size(); i += 2) {
+            search_server.RemoveDocument(i);
+        }
+    }
+    cout << "Segments: "s << search_server.GetSegmentCount() << endl;
+    find_all("Queries with tombstones"sv);
+    {
+        LOG_DURATION("MergeSegments"sv);
+        search_server.MergeSegments();
+    }
+    find_all("Queries after merge"sv);
+}
+
+void BenchmarkResultCache(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 50'000, 70);
+    const auto distinct_queries = GenerateQueries(generator, dictionary, 10'000, 7);
+
+    // The 1% most popular queries make up 40% of the traffic.
+    vector<string_view> queries;
+    for (int i = 0; i < 20'000; ++i) {
+        const bool is_popular = uniform_int_distribution(0, 9)(generator) < 4;
+        const size_t count = is_popular ? distinct_queries.size() / 100 : distinct_queries.size();
+        queries.push_back(distinct_queries[uniform_int_distribution<size_t>(0, count - 1)(generator)]);
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    const auto find_all = [&](string_view mark) {
+        LOG_DURATION(mark);
+        size_t found = 0;
+        for (const string_view query : queries) {
+            found += search_server.FindTopDocuments(query).size();
+        }
+        cout << found << endl;
+    };
+
+    find_all("Without result cache"sv);
+    search_server.SetResultCacheCapacity(4096);
+    find_all("With result cache"sv);
+    const ResultCacheStats stats = search_server.GetResultCacheStats();
+    cout << "Hits: "s << stats.hits << ", misses: "s << stats.misses << ", evictions: "s << stats.evictions << endl;
+}
+
+// Interleaves queries with every change of the index and compares each result of the cached
+// overload with the uncached predicate overload, returns whether no stale result was returned.
+bool CheckResultCache(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 500, 6);
+    const auto texts = GenerateQueries(generator, dictionary, 4'000, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 200, 3);
+
+    SearchServer search_server(dictionary[0]);
+    search_server.SetResultCacheCapacity(1024);
+    size_t stale_count = 0;
+    const auto find_all = [&]() {
+        // The second pass is answered from the cache.
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const string& query : queries) {
+                const vector<Document> expected = search_server.FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) {
+                    return status == DocumentStatus::ACTUAL;
+                    });
+                stale_count += HaveSameDocuments(search_server.FindTopDocuments(query), expected) ? 0 : 1;
+            }
+        }
+    };
+
+    for (size_t i = 0; i < texts.size(); ++i) {
+        search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        if (i % 500 == 499) {
+            find_all();
+        }
+    }
+    for (size_t i = 0; i < texts.size(); i += 3) {
+        search_server.RemoveDocument(i);
+        if (i % 600 == 0) {
+            find_all();
+        }
+    }
+    // A duplicate is added in FLAG mode, in REJECT mode it is refused and nothing changes.
+    search_server.SetDuplicateMode(DuplicateMode::FLAG);
+    find_all();
+    search_server.AddDocument(texts.size(), texts[1], DocumentStatus::ACTUAL, { 4 });
+    find_all();
+    search_server.SetDuplicateMode(DuplicateMode::REJECT);
+    try {
+        search_server.AddDocument(texts.size() + 1, texts[1], DocumentStatus::ACTUAL, { 5 });
+    } catch (const invalid_argument&) {
+    }
+    find_all();
+    search_server.SetMaxResultDocumentCount(20);
+    find_all();
+    search_server.MergeSegments();
+    find_all();
+
+    const ResultCacheStats stats = search_server.GetResultCacheStats();
+    cout << "Result cache, hits: "s << stats.hits << ", stale results: "s << stale_count << endl;
+    return stale_count == 0 && stats.hits > 0;
+}
+
+void BenchmarkBatchQueries(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 50'000, 70);
+    const auto distinct_queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+    vector<string> queries;
+    for (int i = 0; i < 10'000; ++i) {
+        queries.push_back(distinct_queries[uniform_int_distribution<size_t>(0, distinct_queries.size() - 1)(generator)]);
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    cout << "Batch queries, hardware threads: "s << thread::hardware_concurrency() << endl;
+    {
+        LOG_DURATION("Query by query"sv);
+        vector<vector<Document>> results(queries.size());
+        transform(execution::par, queries.begin(), queries.end(), results.begin(), [&search_server](const string& query) {
+            return search_server.FindTopDocuments(query);
+            });
+        cout << results.size() << endl;
+    }
+    ThreadPool pool;
+    {
+        LOG_DURATION("ProcessQueries"sv);
+        cout << ProcessQueries(search_server, queries, pool).size() << endl;
+    }
+}
+
+void BenchmarkJoinedQueries(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 20'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 20'000, 5);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    ThreadPool pool;
+    {
+        LOG_DURATION("Joined by concatenation"sv);
+        vector<Document> joined;
+        for (vector<Document>& documents : ProcessQueries(search_server, queries, pool)) {
+            joined.insert(joined.end(), documents.begin(), documents.end());
+        }
+        cout << joined.size() << endl;
+    }
+    {
+        LOG_DURATION("ProcessQueriesJoined"sv);
+        cout << ProcessQueriesJoined(search_server, queries, pool).size() << endl;
+    }
+    {
+        LOG_DURATION("ProcessQueriesLazy"sv);
+        size_t count = 0;
+        for (const Document& document : ProcessQueriesLazy(search_server, queries, pool)) {
+            count += document.id >= 0 ? 1 : 0;
+        }
+        cout << count << endl;
+    }
+}
+
+void BenchmarkQueryParsing(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 30);
+    // None of the words of these queries is indexed, so finding their documents costs little more than parsing them.
+    const set<string_view> indexed_words(dictionary.begin(), dictionary.end());
+    vector<string> other_dictionary;
+    for (const string& word : GenerateDictionary(generator, 10'000, 10)) {
+        if (indexed_words.count(word) == 0) {
+            other_dictionary.push_back(word);
+        }
+    }
+    vector<string> unknown_queries = GenerateQueries(generator, other_dictionary, 100'000, 3);
+    vector<string> queries = GenerateQueries(generator, dictionary, 100'000, 3);
+    for (size_t i = 0; i < queries.size(); i += 2) {
+        unknown_queries[i] += " -"s + other_dictionary[i % other_dictionary.size()];
+        queries[i] += " -"s + dictionary[i % dictionary.size()];
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+    // The first query sizes the per-thread scratch buffer of the parser.
+    search_server.CountQueryWords(queries[0]);
+
+    const auto measure = [](string_view mark, const vector<string>& queries, const auto& function) {
+        size_t total = 0;
+        uint64_t allocations = 0;
+        {
+            LOG_DURATION(mark);
+            const uint64_t first_allocation = GetAllocationCount();
+            for (const string& query : queries) {
+                total += function(query);
+            }
+            allocations = GetAllocationCount() - first_allocation;
+        }
+        cout << total << ", allocations per query: "s << static_cast<double>(allocations) / queries.size() << endl;
+    };
+
+    measure("Parse into sets of strings"sv, queries, [](const string& query) {
+        set<string, less<>> plus_words;
+        set<string, less<>> minus_words;
+        for (const string_view word : SplitIntoWords(query)) {
+            if (!word.empty() && word[0] == '-') {
+                minus_words.emplace(word.substr(1));
+            }
+            else {
+                plus_words.emplace(word);
+            }
+        }
+        return plus_words.size() + minus_words.size();
+        });
+    measure("Parse into query words"sv, queries, [&search_server](const string& query) {
+        return search_server.CountQueryWords(query);
+        });
+    measure("Short queries of unknown words"sv, unknown_queries, [&search_server](const string& query) {
+        return search_server.FindTopDocuments(query).size();
+        });
+    measure("Parse and score"sv, queries, [&search_server](const string& query) {
+        return search_server.FindTopDocuments(query).size();
+        });
+}
+
+void BenchmarkDuplicateDetection(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto texts = GenerateQueries(generator, dictionary, 20'000, 70);
+
+    // Every fifth document repeats the words of an earlier one in another order.
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < 100'000; ++i) {
+        if (i % 5 == 4) {
+            vector<string_view> words = SplitIntoWords(texts[uniform_int_distribution<size_t>(0, texts.size() - 1)(generator)]);
+            shuffle(words.begin(), words.end(), generator);
+            string text;
+            for (const string_view word : words) {
+                text += word;
+                text += ' ';
+            }
+            search_server.AddDocument(i, text, DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        else {
+            search_server.AddDocument(i, texts[i % texts.size()] + " "s + dictionary[i % dictionary.size()], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+    }
+
+    {
+        LOG_DURATION("Duplicates by sets of words"sv);
+        set<set<string>> word_sets;
+        size_t duplicate_count = 0;
+        for (const int id : search_server) {
+            set<string> words;
+            for (const auto& [word, freq] : search_server.GetWordFrequencies(id)) {
+                words.insert(string(word));
+            }
+            duplicate_count += word_sets.insert(move(words)).second ? 0 : 1;
+        }
+        cout << duplicate_count << endl;
+    }
+    {
+        LOG_DURATION("FindDuplicateDocuments"sv);
+        cout << search_server.FindDuplicateDocuments().size() << endl;
+    }
+    {
+        // The documents that differ from an earlier one by a single added word are found as well.
+        LOG_DURATION("FindNearDuplicateDocuments"sv);
+        cout << search_server.FindNearDuplicateDocuments().size() << endl;
+    }
+}
+
+void BenchmarkMatchDocuments(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 20'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 20);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+
+    {
+        LOG_DURATION("MatchDocument per document"sv);
+        size_t word_count = 0;
+        for (const string& query : queries) {
+            for (const int id : document_ids) {
+                word_count += get<0>(search_server.MatchDocument(query, id)).size();
+            }
+        }
+        cout << word_count << endl;
+    }
+    {
+        LOG_DURATION("MatchDocuments"sv);
+        size_t word_count = 0;
+        MatchedDocuments matches;
+        for (const string& query : queries) {
+            search_server.MatchDocuments(query, document_ids, matches);
+            word_count += matches.words.size();
+        }
+        cout << word_count << endl;
+    }
+}
+
+void BenchmarkShardedServer(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto texts = GenerateQueries(generator, dictionary, 100'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+    vector<NewDocument> documents;
+    documents.reserve(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        documents.push_back({ static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 } });
+    }
+
+    cout << "Sharding, hardware threads: "s << thread::hardware_concurrency() << endl;
+    SearchServer single(dictionary[0]);
+    {
+        LOG_DURATION("Single server AddDocuments"sv);
+        single.AddDocuments(documents);
+    }
+    ShardedSearchServer sharded(dictionary[0]);
+    {
+        LOG_DURATION("Sharded AddDocuments"sv);
+        sharded.AddDocuments(documents);
+    }
+    cout << single.GetDocumentCount() << " "s << sharded.GetDocumentCount() << " in "s << sharded.GetShardCount() << " shards"s << endl;
+
+    vector<vector<Document>> single_results;
+    {
+        LOG_DURATION("Single server queries"sv);
+        for (const string& query : queries) {
+            single_results.push_back(single.FindTopDocuments(query));
+        }
+    }
+    vector<vector<Document>> sharded_results;
+    {
+        LOG_DURATION("Sharded queries"sv);
+        for (const string& query : queries) {
+            sharded_results.push_back(sharded.FindTopDocuments(query));
+        }
+    }
+    size_t different_count = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const bool is_same = single_results[i].size() == sharded_results[i].size()
+            && equal(single_results[i].begin(), single_results[i].end(), sharded_results[i].begin(), [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id && lhs.relevance == rhs.relevance;
+                });
+        different_count += is_same ? 0 : 1;
+    }
+    cout << "Queries with different results: "s << different_count << endl;
+}
+
+// Runs the same queries in both retrieval modes, returns whether every result is identical.
+bool CheckBlockMaxWand(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 2'000, 8);
+    // Squaring a uniform number skews the word frequencies the way natural text does, so that
+    // the per-block bounds differ and the pruning actually skips blocks.
+    const auto skewed_word = [&]() -> const string& {
+        const double x = uniform_real_distribution<>(0, 1)(generator);
+        return dictionary[static_cast<size_t>(x * x * (dictionary.size() - 1))];
+    };
+
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < 30'000; ++i) {
+        string text;
+        const int word_count = uniform_int_distribution(1, 40)(generator);
+        for (int j = 0; j < word_count; ++j) {
+            text += skewed_word();
+            text += ' ';
+        }
+        const DocumentStatus status = static_cast<DocumentStatus>(uniform_int_distribution(0, 3)(generator));
+        search_server.AddDocument(i, text, status, { uniform_int_distribution(-3, 3)(generator) });
+    }
+    // Removed documents keep their postings until a merge, the pruned path must skip them too.
+    for (int i = 0; i < 30'000; i += 7) {
+        search_server.RemoveDocument(i);
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 300; ++i) {
+        string query;
+        const int word_count = uniform_int_distribution(1, 6)(generator);
+        for (int j = 0; j < word_count; ++j) {
+            query += uniform_int_distribution(0, 4)(generator) == 0 ? "-"s : ""s;
+            query += skewed_word();
+            query += ' ';
+        }
+        queries.push_back(query);
+    }
+
+    const auto find_all = [&](RetrievalMode mode, size_t max_count) {
+        search_server.SetRetrievalMode(mode);
+        search_server.SetMaxResultDocumentCount(max_count);
+        vector<vector<Document>> results;
+        for (const string& query : queries) {
+            results.push_back(search_server.FindTopDocuments(query));
+            results.push_back(search_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            results.push_back(search_server.FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) {
+                return document_id % 3 != 0 && rating >= 0;
+                }));
+            results.push_back(search_server.FindTopDocuments(execution::par, query));
+        }
+        return results;
+    };
+
+    // The last count is above the number of matches of any query.
+    size_t different_count = 0;
+    for (const size_t max_count : { 0, 1, 5, 50, 100'000 }) {
+        const vector<vector<Document>> exhaustive_results = find_all(RetrievalMode::EXHAUSTIVE, max_count);
+        const vector<vector<Document>> pruned_results = find_all(RetrievalMode::BLOCK_MAX_WAND, max_count);
+        for (size_t i = 0; i < exhaustive_results.size(); ++i) {
+            different_count += HaveSameDocuments(exhaustive_results[i], pruned_results[i]) ? 0 : 1;
+        }
+    }
+    cout << "Block-Max WAND, queries with different results: "s << different_count << endl;
+    return different_count == 0;
+}
+
+string SaveSnapshotToString(const SearchServer& search_server, const string& path) {
+    search_server.SaveSnapshot(path);
+    ifstream input(path, ios::binary);
+    return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+
+// Applies batches of documents, removals and rejected batches to a VersionedSearchServer while
+// readers query its snapshots. Readers check that no update is seen half-applied, and every
+// published version is compared with a SearchServer that received the successful updates only.
+// The saved snapshots are compared as well, they hold the whole term dictionary, so versions
+// whose dictionaries have drifted apart are caught. Returns whether nothing differed.
+bool CheckVersionedServer(mt19937& generator) {
+    const int batch_size = 10;
+    const auto dictionary = GenerateDictionary(generator, 2'000, 8);
+    const auto texts = GenerateQueries(generator, dictionary, 3'000, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 20, 3);
+
+    SearchServer reference(dictionary[0]);
+    VersionedSearchServer versioned{ SearchServer(dictionary[0]) };
+    reference.SetDuplicateMode(DuplicateMode::REJECT);
+    versioned.ApplyUpdate([](SearchServer& server) {
+        server.SetDuplicateMode(DuplicateMode::REJECT);
+        });
+
+    atomic<bool> is_done = false;
+    atomic<size_t> torn_count = 0;
+    atomic<size_t> reader_query_count = 0;
+    vector<thread> readers;
+    for (int reader = 0; reader < 2; ++reader) {
+        readers.emplace_back([&]() {
+            while (!is_done) {
+                const shared_ptr<const SearchServer> snapshot = versioned.GetSnapshot();
+                for (const string& query : queries) {
+                    snapshot->FindTopDocuments(query);
+                }
+                torn_count += snapshot->GetDocumentCount() % batch_size == 0 ? 0 : 1;
+                ++reader_query_count;
+            }
+            });
+    }
+
+    size_t different_count = 0;
+    vector<NewDocument> documents;
+    for (int first_id = 0; first_id < static_cast<int>(texts.size()); first_id += batch_size) {
+        documents.clear();
+        for (int id = first_id; id < first_id + batch_size; ++id) {
+            documents.push_back({ id, texts[id], DocumentStatus::ACTUAL, { id % 7 } });
+        }
+        versioned.AddDocuments(documents);
+        reference.AddDocuments(documents);
+
+        if (first_id % (batch_size * 7) == batch_size * 6) {
+            const int removed_id = first_id - batch_size * 3;
+            const auto remove_batch = [removed_id, batch_size](SearchServer& server) {
+                for (int id = removed_id; id < removed_id + batch_size; ++id) {
+                    server.RemoveDocument(id);
+                }
+            };
+            versioned.ApplyUpdate(remove_batch);
+            remove_batch(reference);
+        }
+        if (first_id % (batch_size * 5) == batch_size * 4) {
+            // A batch with words no document has had yet, rejected because it repeats a document.
+            const string new_words = "rejected"s + to_string(first_id) + " rejected"s + to_string(first_id + 1);
+            const vector<NewDocument> rejected = {
+                { 100'000 + first_id, new_words, DocumentStatus::ACTUAL, { 1 } },
+                { 100'001 + first_id, texts[first_id], DocumentStatus::ACTUAL, { 1 } },
+            };
+            try {
+                versioned.AddDocuments(rejected);
+                ++different_count;
+            } catch (const invalid_argument&) {
+            }
+        }
+
+        const shared_ptr<const SearchServer> snapshot = versioned.GetSnapshot();
+        different_count += SaveSnapshotToString(*snapshot, "versioned.snapshot"s) == SaveSnapshotToString(reference, "reference.snapshot"s) ? 0 : 1;
+        for (const string& query : queries) {
+            different_count += HaveSameDocuments(snapshot->FindTopDocuments(query), reference.FindTopDocuments(query)) ? 0 : 1;
+        }
+    }
+    is_done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    remove("versioned.snapshot");
+    remove("reference.snapshot");
+    cout << "Versioned server, reader passes: "s << reader_query_count << ", torn snapshots: "s << torn_count
+        << ", differences from the reference: "s << different_count << endl;
+    return torn_count == 0 && different_count == 0;
+}
+
+// Saves an index with stop words, removed documents and every status, maps it back and compares
+// the answers of the snapshot with those of the live server, invalid queries included. Returns
+// whether they all agree and a failed save left no temporary file behind.
+bool CheckSnapshotRoundTrip(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 2'000, 8);
+    const auto texts = GenerateQueries(generator, dictionary, 10'000, 30);
+    vector<string> queries = GenerateQueries(generator, dictionary, 200, 4);
+    for (size_t i = 0; i < queries.size(); i += 3) {
+        queries[i] += " -"s + dictionary[i % dictionary.size()];
+    }
+    queries.push_back(dictionary[0] + " "s + dictionary[1]);
+    queries.push_back("unknownword -"s + dictionary[2]);
+
+    SearchServer search_server(dictionary[0] + " "s + dictionary[1]);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        search_server.AddDocument(i, texts[i], static_cast<DocumentStatus>(i % 4), { static_cast<int>(i % 11) - 5 });
+    }
+    for (size_t i = 0; i < texts.size(); i += 9) {
+        search_server.RemoveDocument(i);
+    }
+    const string path = "search_system_check.snapshot"s;
+    search_server.SaveSnapshot(path);
+
+    size_t different_count = 0;
+    for (const SnapshotVerification verification : { SnapshotVerification::FULL, SnapshotVerification::HEADER }) {
+        const SnapshotSearchServer snapshot(path, verification);
+        different_count += snapshot.GetDocumentCount() == search_server.GetDocumentCount()
+            && equal(snapshot.begin(), snapshot.end(), search_server.begin(), search_server.end()) ? 0 : 1;
+        const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return status != DocumentStatus::BANNED && rating > 0;
+        };
+        for (const string& query : queries) {
+            different_count += HaveSameDocuments(snapshot.FindTopDocuments(query), search_server.FindTopDocuments(query)) ? 0 : 1;
+            different_count += HaveSameDocuments(snapshot.FindTopDocuments(query, DocumentStatus::IRRELEVANT), search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT)) ? 0 : 1;
+            different_count += HaveSameDocuments(snapshot.FindTopDocuments(query, predicate), search_server.FindTopDocuments(query, predicate)) ? 0 : 1;
+            different_count += HaveSameDocuments(snapshot.FindTopDocuments(execution::par, query), search_server.FindTopDocuments(execution::par, query)) ? 0 : 1;
+            // None of these ids is a multiple of 9, so none is removed.
+            for (int id = 1; id < 100; id += 9) {
+                const auto [snapshot_words, snapshot_status] = snapshot.MatchDocument(query, id);
+                const auto [words, status] = search_server.MatchDocument(query, id);
+                different_count += snapshot_words == words && snapshot_status == status ? 0 : 1;
+            }
+        }
+        for (const string& query : { "-"s, "--"s + dictionary[3], dictionary[3] + "\x01"s }) {
+            bool is_rejected = false;
+            try {
+                snapshot.FindTopDocuments(query);
+            } catch (const invalid_argument&) {
+                is_rejected = true;
+            }
+            try {
+                search_server.FindTopDocuments(query);
+            } catch (const invalid_argument&) {
+                is_rejected = !is_rejected;
+            }
+            different_count += is_rejected ? 1 : 0;
+        }
+    }
+    filesystem::remove(path);
+
+    // Saving over a directory fails at the final rename, after the whole file has been written.
+    const string directory_path = "search_system_check_directory"s;
+    filesystem::create_directories(directory_path + "/child"s);
+    bool is_saved = true;
+    try {
+        search_server.SaveSnapshot(directory_path);
+    } catch (const runtime_error&) {
+        is_saved = false;
+    }
+    const bool is_temp_left = filesystem::exists(directory_path + ".tmp"s);
+    filesystem::remove_all(directory_path);
+
+    cout << "Snapshot round trip, differences: "s << different_count << ", temporary file left: "s << (is_temp_left ? "yes"s : "no"s) << endl;
+    return different_count == 0 && !is_saved && !is_temp_left;
+}
+
+// Feeds known latencies to histograms and a known mix of requests to a RequestQueue, returns
+// whether the counts and the percentiles come out as expected.
+bool CheckRequestStats() {
+    bool is_correct = true;
+    // 1..1000 microseconds, so the p-th percentile is 10 * p microseconds.
+    LatencyHistogram histogram;
+    LatencyHistogram lower_half;
+    LatencyHistogram upper_half;
+    for (uint64_t latency_us = 1'000; latency_us >= 1; --latency_us) {
+        histogram.Add(latency_us * 1'000);
+        (latency_us <= 500 ? lower_half : upper_half).Add(latency_us * 1'000);
+    }
+    LatencyHistogram merged;
+    merged.Merge(upper_half);
+    merged.Merge(lower_half);
+    is_correct = is_correct && histogram.GetCount() == 1'000 && merged.GetCount() == 1'000;
+    for (const double percentile : { 1.0, 25.0, 50.0, 90.0, 99.0, 100.0 }) {
+        const uint64_t expected_ns = static_cast<uint64_t>(percentile * 10'000);
+        const uint64_t reported_ns = histogram.GetPercentile(percentile);
+        // A percentile is the upper bound of its bucket, at most 1/8 above the values in it.
+        is_correct = is_correct && reported_ns >= expected_ns && reported_ns <= expected_ns + expected_ns / 8;
+        is_correct = is_correct && merged.GetPercentile(percentile) == reported_ns;
+    }
+    // Latencies below 8 ns have a bucket each.
+    LatencyHistogram small;
+    for (uint64_t latency_ns = 0; latency_ns < 8; ++latency_ns) {
+        small.Add(latency_ns);
+    }
+    is_correct = is_correct && small.GetPercentile(50) == 3 && small.GetPercentile(100) == 7 && LatencyHistogram().GetPercentile(50) == 0;
+
+    // Only every fourth request finds its single document, the window keeps the last 1440.
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, { 1 });
+    RequestQueue request_queue(search_server);
+    for (int i = 0; i < 2'000; ++i) {
+        request_queue.AddFindRequest(i % 4 == 0 ? "cat"s : "dog"s);
+    }
+    const RequestStats stats = request_queue.GetStats();
+    is_correct = is_correct && stats.request_count == RequestQueue::REQUEST_WINDOW && stats.latencies.GetCount() == RequestQueue::REQUEST_WINDOW
+        && stats.no_result_count == 1'080 && stats.document_count == 360 && request_queue.GetNoResultRequests() == 1'080
+        && request_queue.GetStats(chrono::hours(1)).request_count == RequestQueue::REQUEST_WINDOW;
+
+    // Writers on several threads: every record in the window is a complete one.
+    vector<thread> writers;
+    for (int writer = 0; writer < 4; ++writer) {
+        writers.emplace_back([&request_queue]() {
+            for (int i = 0; i < 1'000; ++i) {
+                request_queue.AddFindRequest("cat"s);
+            }
+            });
+    }
+    for (thread& writer : writers) {
+        writer.join();
+    }
+    const RequestStats concurrent_stats = request_queue.GetStats();
+    is_correct = is_correct && concurrent_stats.request_count == RequestQueue::REQUEST_WINDOW
+        && concurrent_stats.no_result_count == 0 && concurrent_stats.document_count == RequestQueue::REQUEST_WINDOW;
+
+    cout << "Request stats: "s << (is_correct ? "as expected"s : "wrong"s) << ", p50 of 1..1000 us: "s << histogram.GetPercentile(50) / 1000 << " us"s << endl;
+    return is_correct;
+}
+
+void PrintLoadStats(string_view mark, const RequestStats& stats) {
+    cout << mark << ": "s << static_cast<uint64_t>(stats.queries_per_second) << " queries/s, p50 "s
+        << stats.latencies.GetPercentile(50) / 1000 << " us, p99 "s << stats.latencies.GetPercentile(99) / 1000 << " us"s << endl;
+}
+
+void BenchmarkQueryService(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto texts = GenerateQueries(generator, dictionary, 20'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+    SearchServer search_server(dictionary[0]);
+    ThreadPool pool;
+    QueryServiceOptions options;
+    options.unix_socket_path = "search_system_benchmark.sock"s;
+    unique_ptr<QueryService> service;
+    try {
+        service = make_unique<QueryService>(search_server, pool, options);
+    } catch (const runtime_error& error) {
+        cout << "Query service skipped: "s << error.what() << endl;
+        return;
+    }
+    thread service_thread([&service]() {
+        service->Run();
+        });
+
+    cout << "Query service, hardware threads: "s << thread::hardware_concurrency() << endl;
+    const auto connect_tcp = [&service]() {
+        return QueryClient::ConnectTcp("127.0.0.1"s, service->GetTcpPort());
+    };
+    const auto connect_unix = [&options]() {
+        return QueryClient::ConnectUnix(options.unix_socket_path);
+    };
+    {
+        LOG_DURATION("Pipelined AddDocument"sv);
+        QueryClient client = connect_tcp();
+        size_t added_count = 0;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            client.SendAddDocument(i, texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+            if (i + 1 - added_count == 64) {
+                client.ReceiveEmpty();
+                ++added_count;
+            }
+        }
+        for (; added_count < texts.size(); ++added_count) {
+            client.ReceiveEmpty();
+        }
+    }
+    cout << search_server.GetDocumentCount() << " documents"s << endl;
+
+    vector<vector<Document>> remote_results;
+    {
+        QueryClient client = connect_unix();
+        for (const string& query : queries) {
+            client.SendFindTopDocuments(query);
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            remote_results.push_back(client.ReceiveDocuments());
+        }
+        try {
+            client.FindTopDocuments("--invalid"s);
+            cout << "Invalid query accepted"s << endl;
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    PrintLoadStats("TCP, 1 connection, depth 1"sv, RunQueryLoad(connect_tcp, queries, { 1, 2'000, 1 }));
+    PrintLoadStats("TCP, 1 connection, depth 16"sv, RunQueryLoad(connect_tcp, queries, { 1, 2'000, 16 }));
+    PrintLoadStats("TCP, 4 connections, depth 16"sv, RunQueryLoad(connect_tcp, queries, { 4, 2'000, 16 }));
+    PrintLoadStats("Unix, 4 connections, depth 16"sv, RunQueryLoad(connect_unix, queries, { 4, 2'000, 16 }));
+
+    service->Stop();
+    service_thread.join();
+
+    size_t different_count = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const vector<Document> local_results = search_server.FindTopDocuments(queries[i]);
+        const bool is_same = local_results.size() == remote_results[i].size()
+            && equal(local_results.begin(), local_results.end(), remote_results[i].begin(), [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+                });
+        different_count += is_same ? 0 : 1;
+    }
+    cout << "Queries with different results: "s << different_count << endl;
+}
+
+template <typename Map>
+void BenchmarkAccumulator(string_view mark, Map& map, const vector<int>& keys) {
+    {
+        LOG_DURATION(mark);
+        for_each(execution::par, keys.begin(), keys.end(), [&map](int key) {
+            map[key].ref_to_value += 1.0;
+            });
+    }
+    double total = 0;
+    for (const auto& [key, value] : map.BuildOrdinaryMap()) {
+        total += value;
+    }
+    cout << total << endl;
+}
+
+void BenchmarkConcurrentMaps(mt19937& generator) {
+    vector<int> keys(2'000'000);
+    for (int& key : keys) {
+        key = uniform_int_distribution(0, 9'999)(generator);
+    }
+
+    cout << "Concurrent accumulator, hardware threads: "s << thread::hardware_concurrency() << endl;
+    ConcurrentMap<int, double> locked_map(8);
+    BenchmarkAccumulator("ConcurrentMap, 8 buckets"sv, locked_map, keys);
+    ConcurrentMap<int, double> striped_map(1024);
+    BenchmarkAccumulator("ConcurrentMap, 1024 buckets"sv, striped_map, keys);
+    ConcurrentHashMap<int, double> lock_free_map(10'000);
+    BenchmarkAccumulator("ConcurrentHashMap"sv, lock_free_map, keys);
+}
+
+// Search_System serve <port> [unix socket path]
+//     serves an empty SearchServer until the process is killed.
+// Search_System load <port> [connections] [pipeline depth]
+//     adds generated documents through a running service and reports the query throughput.
+int RunCommand(const vector<string>& arguments) {
+    if (arguments[0] == "serve"s && arguments.size() >= 2) {
+        SearchServer search_server(""s);
+        ThreadPool pool;
+        QueryServiceOptions options;
+        options.tcp_port = static_cast<uint16_t>(stoi(arguments[1]));
+        options.unix_socket_path = arguments.size() >= 3 ? arguments[2] : ""s;
+        QueryService service(search_server, pool, options);
+        cout << "Listening on port "s << service.GetTcpPort() << endl;
+        service.Run();
+        return 0;
+    }
+    if (arguments[0] == "load"s && arguments.size() >= 2) {
+        const uint16_t port = static_cast<uint16_t>(stoi(arguments[1]));
+        QueryLoadOptions options;
+        options.connection_count = arguments.size() >= 3 ? stoul(arguments[2]) : options.connection_count;
+        options.pipeline_depth = arguments.size() >= 4 ? stoul(arguments[3]) : options.pipeline_depth;
+
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+        const auto texts = GenerateQueries(generator, dictionary, 10'000, 70);
+        const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+        const auto connect = [port]() {
+            return QueryClient::ConnectTcp("127.0.0.1"s, port);
+        };
+        QueryClient client = connect();
+        for (size_t i = 0; i < texts.size(); ++i) {
+            client.SendAddDocument(i, texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        for (size_t i = 0; i < texts.size(); ++i) {
+            // Documents already added by an earlier run are reported and skipped.
+            try {
+                client.ReceiveEmpty();
+            } catch (const invalid_argument&) {
+            }
+        }
+        PrintLoadStats("Load"sv, RunQueryLoad(connect, queries, options));
+        return 0;
+    }
+    cerr << "Usage: Search_System [serve <port> [unix socket path] | load <port> [connections] [pipeline depth]]"s << endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return RunCommand(vector<string>(argv + 1, argv + argc));
+    }
+
     mt19937 generator;
 
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
@@ -87,6 +992,34 @@ int main() {
 
     TEST(seq);
     TEST(par);
+
+    BenchmarkBroadQueries(generator);
+    if (!CheckBlockMaxWand(generator)) {
+        return 1;
+    }
+    BenchmarkConcurrentMaps(generator);
+    BenchmarkBulkIndexing(generator);
+    BenchmarkRemoveDocuments(generator);
+    BenchmarkResultCache(generator);
+    if (!CheckResultCache(generator)) {
+        return 1;
+    }
+    BenchmarkBatchQueries(generator);
+    BenchmarkJoinedQueries(generator);
+    BenchmarkQueryParsing(generator);
+    BenchmarkDuplicateDetection(generator);
+    BenchmarkMatchDocuments(generator);
+    BenchmarkShardedServer(generator);
+    if (!CheckVersionedServer(generator)) {
+        return 1;
+    }
+    if (!CheckSnapshotRoundTrip(generator)) {
+        return 1;
+    }
+    if (!CheckRequestStats()) {
+        return 1;
+    }
+    BenchmarkQueryService(generator);
     std::cout << "OK" << std::endl;
 }
 
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// The program replaces the global operator new to count its calls, so that benchmarks can show
+// how many heap allocations a code path makes. Aligned allocations are not counted.
+uint64_t GetAllocationCount();
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Lock-free alternative to ConcurrentMap for integer keys and arithmetic values. Slots live in a
+// fixed open-addressing table: a key is claimed with a single CAS and values are updated with
+// atomic read-modify-write operations, so concurrent writers never block each other.
+// The table never grows: it is sized for at least the number of keys passed to the constructor.
+template <typename Key, typename Value>
+class ConcurrentHashMap {
+public:
+    static_assert(std::is_integral_v<Key>, "ConcurrentHashMap supports only integer keys");
+    static_assert(std::is_arithmetic_v<Value>, "ConcurrentHashMap supports only arithmetic values");
+
+    static constexpr Key EMPTY_KEY = std::numeric_limits<Key>::max();
+
+    class AtomicValue {
+    public:
+        AtomicValue& operator+=(Value delta) {
+            if constexpr (std::is_integral_v<Value>) {
+                value_.fetch_add(delta, std::memory_order_relaxed);
+            }
+            else {
+                Value expected = value_.load(std::memory_order_relaxed);
+                while (!value_.compare_exchange_weak(expected, expected + delta, std::memory_order_relaxed)) {
+                }
+            }
+            return *this;
+        }
+
+        AtomicValue& operator=(Value value) {
+            value_.store(value, std::memory_order_relaxed);
+            return *this;
+        }
+
+        operator Value() const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<Value> value_{};
+    };
+
+    struct Access {
+        AtomicValue& ref_to_value;
+    };
+
+    explicit ConcurrentHashMap(size_t capacity)
+        : slots_(RoundUpToPowerOfTwo(capacity * 2)) {
+    }
+
+    Access operator[](const Key& key) {
+        if (key == EMPTY_KEY) {
+            throw std::invalid_argument("ConcurrentHashMap reserves the maximum key value");
+        }
+        const size_t mask = slots_.size() - 1;
+        size_t index = Hash(key) & mask;
+        for (size_t probe = 0; probe < slots_.size(); ++probe, index = (index + 1) & mask) {
+            Slot& slot = slots_[index];
+            Key current = slot.key.load(std::memory_order_acquire);
+            if (current == EMPTY_KEY
+                && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                size_.fetch_add(1, std::memory_order_relaxed);
+                return { slot.value };
+            }
+            if (current == key) {
+                return { slot.value };
+            }
+        }
+        throw std::length_error("ConcurrentHashMap is full");
+    }
+
+    // Visits the stored pairs in place, without copying the table. Concurrent updates made during
+    // the walk may or may not be observed.
+    template <typename Callback>
+    void ForEach(Callback callback) const {
+        for (const Slot& slot : slots_) {
+            const Key key = slot.key.load(std::memory_order_acquire);
+            if (key != EMPTY_KEY) {
+                callback(key, static_cast<Value>(slot.value));
+            }
+        }
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        std::map<Key, Value> result;
+        ForEach([&result](Key key, Value value) {
+            result.emplace(key, value);
+            });
+        return result;
+    }
+
+    size_t size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<Key> key{ EMPTY_KEY };
+        AtomicValue value;
+    };
+
+    std::vector<Slot> slots_;
+    std::atomic<size_t> size_{ 0 };
+
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 16;
+        while (result < value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    static size_t Hash(Key key) {
+        // splitmix64 finalizer: spreads sequential keys over the whole table
+        uint64_t x = static_cast<uint64_t>(key);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<size_t>(x ^ (x >> 31));
+    }
+};
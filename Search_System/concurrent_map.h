@@ -1,3 +1,5 @@
+#pragma once
+
 #include <cstdlib>
 #include <map>
 #include <mutex>
@@ -11,7 +13,8 @@ using namespace std::string_literals;
 template <typename Key, typename Value>
 class ConcurrentMap {
 private:
-    struct Bucket {
+    // Buckets are padded to a cache line so that neighbouring mutexes do not false-share.
+    struct alignas(64) Bucket {
         std::mutex mutex;
         std::map<Key, Value> map;
     };
@@ -0,0 +1,16 @@
+#include "document_scorer.h"
+
+void DocumentScorer::CollectTopDocuments(const ScoreAccumulator& accumulator, TopDocuments& top_documents) const {
+    for (const uint32_t ordinal : accumulator.GetTouched()) {
+        top_documents.Push({
+            columns_.ids[ordinal],
+            accumulator.GetRelevance(ordinal) / columns_.lengths[ordinal],
+            columns_.ratings[ordinal]
+            });
+    }
+}
+
+uint32_t DocumentScorer::GetPartitionCount() const {
+    const uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    return std::clamp(columns_.count / MIN_PARTITION_DOCUMENT_COUNT, 1u, thread_count * 4);
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+
+enum class RetrievalMode {
+    EXHAUSTIVE,
+    BLOCK_MAX_WAND,
+};
+
+// Attribute columns indexed by document ordinal. Removed documents may still have postings, they
+// are marked in removed, which is null when every ordinal is live.
+struct DocumentColumns {
+    const int* ids;
+    const int* ratings;
+    const DocumentStatus* statuses;
+    // Words of the document that are not stop words, the denominator of its term frequencies.
+    const uint32_t* lengths;
+    uint32_t count;
+    const uint8_t* removed = nullptr;
+};
+
+struct WeightedPostings {
+    PostingListView postings;
+    double inverse_document_freq;
+};
+
+struct QueryTerms {
+    std::vector<WeightedPostings> plus_terms;
+    std::vector<PostingListView> minus_terms;
+};
+
+// Evaluates resolved query terms over posting list views and attribute columns. It does not care
+// whether they live in a SearchServer or in a memory-mapped snapshot.
+class DocumentScorer {
+public:
+    DocumentScorer(const DocumentColumns& columns, RetrievalMode mode, size_t max_result_document_count)
+        : columns_(columns), mode_(mode), max_result_document_count_(max_result_document_count) {
+    }
+
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(const QueryTerms& terms, Predicate& predicate) const;
+
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const QueryTerms& terms, Predicate& predicate) const;
+
+private:
+    static constexpr uint32_t MIN_PARTITION_DOCUMENT_COUNT = 4096;
+
+    DocumentColumns columns_;
+
+    RetrievalMode mode_;
+
+    size_t max_result_document_count_;
+
+    bool IsRemoved(uint32_t ordinal) const {
+        return columns_.removed != nullptr && columns_.removed[ordinal] != 0;
+    }
+
+    template <typename Predicate>
+    size_t SelectDocuments(const Posting* postings, size_t count, Predicate& predicate, Posting* selected) const;
+
+    template <typename Predicate>
+    void FindAllDocuments(const QueryTerms& terms, Predicate& predicate, uint32_t begin_ordinal, uint32_t end_ordinal, ScoreAccumulator& accumulator) const;
+
+    void CollectTopDocuments(const ScoreAccumulator& accumulator, TopDocuments& top_documents) const;
+
+    template <typename Predicate>
+    void FindTopDocumentsPruned(const QueryTerms& terms, Predicate& predicate, uint32_t begin_ordinal, uint32_t end_ordinal, TopDocuments& top_documents) const;
+
+    template <typename Predicate>
+    void FindTopDocuments(const QueryTerms& terms, Predicate& predicate, uint32_t begin_ordinal, uint32_t end_ordinal, TopDocuments& top_documents) const;
+
+    uint32_t GetPartitionCount() const;
+};
+
+template <typename Predicate>
+size_t DocumentScorer::SelectDocuments(const Posting* postings, size_t count, Predicate& predicate, Posting* selected) const {
+    // Branch-free compaction over a decoded block: the attribute columns are plain arrays indexed
+    // by ordinal, so the predicate is evaluated for the whole block before any scoring.
+    size_t selected_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t ordinal = postings[i].document_id;
+        selected[selected_count] = postings[i];
+        selected_count += !IsRemoved(ordinal) && predicate(columns_.ids[ordinal], columns_.statuses[ordinal], columns_.ratings[ordinal]) ? 1 : 0;
+    }
+    return selected_count;
+}
+
+template <typename Predicate>
+void DocumentScorer::FindAllDocuments(const QueryTerms& terms, Predicate& predicate, uint32_t begin_ordinal, uint32_t end_ordinal, ScoreAccumulator& accumulator) const {
+    accumulator.Reset(columns_.count);
+
+    for (const PostingListView& postings : terms.minus_terms) {
+        postings.ForEachBlock(begin_ordinal, end_ordinal, [&accumulator](const Posting* block, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                accumulator.Exclude(block[i].document_id);
+            }
+            });
+    }
+
+    // Every term of a document shares its length, so the accumulator sums term counts weighted by
+    // IDF and the sum is divided by the length once per document when it is collected.
+    std::array<Posting, PostingListView::BLOCK_SIZE> selected;
+    for (const auto& [postings, inverse_document_freq] : terms.plus_terms) {
+        postings.ForEachBlock(begin_ordinal, end_ordinal, [&, inverse_document_freq = inverse_document_freq](const Posting* block, size_t count) {
+            const size_t selected_count = SelectDocuments(block, count, predicate, selected.data());
+            for (size_t i = 0; i < selected_count; ++i) {
+                accumulator.Add(selected[i].document_id, selected[i].term_count * inverse_document_freq);
+            }
+            });
+    }
+}
+
+template <typename Predicate>
+void DocumentScorer::FindTopDocumentsPruned(const QueryTerms& terms, Predicate& predicate, uint32_t begin_ordinal, uint32_t end_ordinal, TopDocuments& top_documents) const {
+    // Block-Max WAND. Cursors are kept ordered by their current document; a document is only
+    // evaluated when the sum of the per-term, and then per-block, relevance bounds of the cursors
+    // that can contain it reaches the relevance that is needed to enter the current top.
+    if (max_result_document_count_ == 0) {
+        return;
+    }
+
+    struct TermCursor {
+        PostingListView::Cursor cursor;
+        double inverse_document_freq;
+        double max_relevance;
+    };
+
+    std::vector<TermCursor> plus_cursors;
+    plus_cursors.reserve(terms.plus_terms.size());
+    for (const auto& [postings, inverse_document_freq] : terms.plus_terms) {
+        plus_cursors.push_back({ PostingListView::Cursor(postings), inverse_document_freq, postings.GetMaxTermFreq() * inverse_document_freq });
+        plus_cursors.back().cursor.NextGeq(begin_ordinal);
+    }
+    std::vector<PostingListView::Cursor> minus_cursors;
+    minus_cursors.reserve(terms.minus_terms.size());
+    for (const PostingListView& postings : terms.minus_terms) {
+        minus_cursors.emplace_back(postings).NextGeq(begin_ordinal);
+    }
+
+    std::vector<size_t> order(plus_cursors.size());
+    std::iota(order.begin(), order.end(), 0);
+    const auto document_at = [&plus_cursors, &order](size_t position) {
+        return plus_cursors[order[position]].cursor.GetDocumentId();
+    };
+    const auto sort_cursors = [&]() {
+        // Only a few cursors move per step, so insertion sort is close to linear here.
+        for (size_t i = 1; i < order.size(); ++i) {
+            const size_t cursor = order[i];
+            const uint32_t document = plus_cursors[cursor].cursor.GetDocumentId();
+            size_t j = i;
+            for (; j > 0 && document_at(j - 1) > document; --j) {
+                order[j] = order[j - 1];
+            }
+            order[j] = cursor;
+        }
+    };
+    sort_cursors();
+
+    while (true) {
+        // A relevance less than RELEVANCE_EPSILON below the least relevant kept document may share
+        // its bucket and still win on rating, the extra epsilon covers rounding differences
+        // between the bounds and the sums.
+        const double threshold = top_documents.IsFull()
+            ? top_documents.GetLeastRelevant().relevance - 2 * RELEVANCE_EPSILON
+            : -std::numeric_limits<double>::infinity();
+
+        size_t pivot = order.size();
+        double upper_bound = 0;
+        for (size_t i = 0; i < order.size() && document_at(i) < end_ordinal; ++i) {
+            upper_bound += plus_cursors[order[i]].max_relevance;
+            if (upper_bound >= threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) {
+            break;
+        }
+        const uint32_t pivot_document = document_at(pivot);
+        while (pivot + 1 < order.size() && document_at(pivot + 1) == pivot_document) {
+            ++pivot;
+        }
+
+        double block_upper_bound = 0;
+        uint32_t next_document = pivot + 1 < order.size() ? document_at(pivot + 1) : PostingListView::Cursor::END;
+        for (size_t i = 0; i <= pivot; ++i) {
+            const TermCursor& term_cursor = plus_cursors[order[i]];
+            const PostingBlockHeader* header = term_cursor.cursor.FindBlockHeader(pivot_document);
+            if (header != nullptr) {
+                block_upper_bound += header->max_term_freq * term_cursor.inverse_document_freq;
+                next_document = std::min(next_document, header->last_document_id + 1);
+            }
+        }
+
+        if (block_upper_bound < threshold) {
+            for (size_t i = 0; i <= pivot; ++i) {
+                plus_cursors[order[i]].cursor.NextGeq(next_document);
+            }
+        }
+        else if (document_at(0) != pivot_document) {
+            for (size_t i = 0; i < pivot && document_at(i) < pivot_document; ++i) {
+                plus_cursors[order[i]].cursor.NextGeq(pivot_document);
+            }
+        }
+        else {
+            bool excluded = false;
+            for (PostingListView::Cursor& cursor : minus_cursors) {
+                cursor.NextGeq(pivot_document);
+                excluded = excluded || cursor.GetDocumentId() == pivot_document;
+            }
+            if (!excluded && !IsRemoved(pivot_document) && predicate(columns_.ids[pivot_document], columns_.statuses[pivot_document], columns_.ratings[pivot_document])) {
+                // Summed in query term order, exactly like the exhaustive path.
+                double weighted_count = 0;
+                for (const TermCursor& term_cursor : plus_cursors) {
+                    if (term_cursor.cursor.GetDocumentId() == pivot_document) {
+                        weighted_count += term_cursor.cursor.GetTermCount() * term_cursor.inverse_document_freq;
+                    }
+                }
+                top_documents.Push({ columns_.ids[pivot_document], weighted_count / columns_.lengths[pivot_document], columns_.ratings[pivot_document] });
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                plus_cursors[order[i]].cursor.Next();
+            }
+        }
+        sort_cursors();
+    }
+}
+
+template <typename Predicate>
+void DocumentScorer::FindTopDocuments(const QueryTerms& terms, Predicate& predicate, uint32_t begin_ordinal, uint32_t end_ordinal, TopDocuments& top_documents) const {
+    if (mode_ == RetrievalMode::BLOCK_MAX_WAND) {
+        FindTopDocumentsPruned(terms, predicate, begin_ordinal, end_ordinal, top_documents);
+        return;
+    }
+    ScoreAccumulator& accumulator = ScoreAccumulator::ForThisThread();
+    FindAllDocuments(terms, predicate, begin_ordinal, end_ordinal, accumulator);
+    CollectTopDocuments(accumulator, top_documents);
+}
+
+template <typename Predicate>
+std::vector<Document> DocumentScorer::FindTopDocuments(const QueryTerms& terms, Predicate& predicate) const {
+    TopDocuments top_documents(max_result_document_count_);
+    FindTopDocuments(terms, predicate, 0, columns_.count, top_documents);
+    return top_documents.Extract();
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> DocumentScorer::FindTopDocuments(ExecutionPolicy&& policy, const QueryTerms& terms, Predicate& predicate) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        return FindTopDocuments(terms, predicate);
+    }
+    else {
+        // Every partition scores its own range of ordinals into the accumulator of the thread
+        // that runs it, so workers never share a score slot and need no locks.
+        std::vector<uint32_t> partitions(GetPartitionCount());
+        std::iota(partitions.begin(), partitions.end(), 0);
+        std::vector<std::vector<Document>> partition_documents(partitions.size());
+
+        std::for_each(policy, partitions.begin(), partitions.end(), [&](uint32_t partition) {
+            const uint32_t begin_ordinal = static_cast<uint32_t>(uint64_t{ columns_.count } * partition / partitions.size());
+            const uint32_t end_ordinal = static_cast<uint32_t>(uint64_t{ columns_.count } * (partition + 1) / partitions.size());
+            TopDocuments top_documents(max_result_document_count_);
+            FindTopDocuments(terms, predicate, begin_ordinal, end_ordinal, top_documents);
+            partition_documents[partition] = top_documents.Extract();
+            });
+
+        TopDocuments top_documents(max_result_document_count_);
+        for (const std::vector<Document>& documents : partition_documents) {
+            for (const Document& document : documents) {
+                top_documents.Push(document);
+            }
+        }
+        return top_documents.Extract();
+    }
+}
@@ -0,0 +1,14 @@
+#include "document_signature.h"
+
+namespace {
+    // Finalizer of splitmix64, every input bit affects every output bit.
+    uint64_t Mix(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+}
+
+DocumentSignature DocumentSignatureBuilder::Get() const {
+    return { Mix(low_ ^ count_), Mix(high_ + Mix(count_)) };
+}
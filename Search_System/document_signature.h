@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 128-bit fingerprint of the set of term ids of a document. Equal sets always have equal
+// signatures and different sets practically never do, callers still compare the sets of matching
+// signatures before treating documents as duplicates.
+struct DocumentSignature {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const DocumentSignature& other) const {
+        return low == other.low && high == other.high;
+    }
+
+    bool operator!=(const DocumentSignature& other) const {
+        return !(*this == other);
+    }
+};
+
+struct DocumentSignatureHasher {
+    size_t operator()(const DocumentSignature& signature) const {
+        return static_cast<size_t>(signature.low);
+    }
+};
+
+// Builds a signature from the term ids of a document in increasing order, each id once.
+class DocumentSignatureBuilder {
+public:
+    void Add(uint32_t term_id) {
+        // Two independent multiplicative hashes of the sequence, one per half of the signature.
+        low_ = (low_ ^ term_id) * 0x9e3779b97f4a7c15ull;
+        low_ ^= low_ >> 32;
+        high_ = (high_ + term_id + 0x632be59bd9b4e019ull) * 0xbf58476d1ce4e5b9ull;
+        high_ ^= high_ >> 29;
+        ++count_;
+    }
+
+    DocumentSignature Get() const;
+
+private:
+    uint64_t low_ = 0;
+    uint64_t high_ = 0;
+    uint64_t count_ = 0;
+};
@@ -0,0 +1,64 @@
+#include "forward_index.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+ForwardIndex::ForwardIndex()
+    : offsets_{ 0 }
+{}
+
+uint32_t ForwardIndex::GetDocumentCount() const {
+    return static_cast<uint32_t>(offsets_.size() - 1);
+}
+
+size_t ForwardIndex::GetEntryCount() const {
+    return entries_.size();
+}
+
+void ForwardIndex::AddDocument(const std::vector<TermCount>& term_counts) {
+    entries_.insert(entries_.end(), term_counts.begin(), term_counts.end());
+    offsets_.push_back(entries_.size());
+}
+
+void ForwardIndex::AddDocuments(const std::vector<std::vector<TermCount>>& documents) {
+    const size_t first_document = offsets_.size() - 1;
+    for (const std::vector<TermCount>& term_counts : documents) {
+        offsets_.push_back(offsets_.back() + term_counts.size());
+    }
+    entries_.resize(offsets_.back());
+
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        std::copy(documents[index].begin(), documents[index].end(), entries_.begin() + offsets_[first_document + index]);
+        });
+}
+
+void ForwardIndex::RemoveDocument(uint32_t ordinal) {
+    removed_entry_count_ += offsets_[ordinal + 1] - offsets_[ordinal];
+}
+
+size_t ForwardIndex::GetRemovedEntryCount() const {
+    return removed_entry_count_;
+}
+
+void ForwardIndex::Compact(const std::vector<uint8_t>& is_removed) {
+    // Entries only move towards the front, so the array is compacted in place.
+    uint64_t entry_count = 0;
+    for (uint32_t ordinal = 0; ordinal < GetDocumentCount(); ++ordinal) {
+        const uint64_t begin = offsets_[ordinal];
+        const uint64_t end = offsets_[ordinal + 1];
+        offsets_[ordinal] = entry_count;
+        if (!is_removed[ordinal]) {
+            if (entry_count != begin) {
+                std::copy(entries_.begin() + begin, entries_.begin() + end, entries_.begin() + entry_count);
+            }
+            entry_count += end - begin;
+        }
+    }
+    offsets_.back() = entry_count;
+    entries_.resize(entry_count);
+    entries_.shrink_to_fit();
+    removed_entry_count_ = 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "paginator.h"
+#include "term_dictionary.h"
+
+// Occurrences of a term in a document. A count takes no more room than padding would after the
+// term id, so it is kept whole rather than narrowed.
+struct TermCount {
+    uint32_t term_id;
+    uint32_t count;
+};
+
+// Terms of every document in compressed sparse row layout: the terms of the document with
+// ordinal i are entries_[offsets_[i], offsets_[i + 1]) in increasing order of term ids, so a
+// document is read with one sequential scan. The entries of a removed document stay in place
+// until Compact drops them.
+class ForwardIndex {
+public:
+    using TermRange = IteratorRange<std::vector<TermCount>::const_iterator>;
+
+    ForwardIndex();
+
+    TermRange GetTerms(uint32_t ordinal) const {
+        return TermRange(entries_.begin() + offsets_[ordinal], entries_.begin() + offsets_[ordinal + 1]);
+    }
+
+    uint32_t GetDocumentCount() const;
+
+    size_t GetEntryCount() const;
+
+    // term_counts must be in increasing order of term ids.
+    void AddDocument(const std::vector<TermCount>& term_counts);
+
+    // Adds a document per element of documents using all cores.
+    void AddDocuments(const std::vector<std::vector<TermCount>>& documents);
+
+    // Counts the entries of the document as garbage, they are still returned by GetTerms.
+    void RemoveDocument(uint32_t ordinal);
+
+    // Entries of removed documents that are still stored.
+    size_t GetRemovedEntryCount() const;
+
+    // Drops the entries of the documents marked in is_removed, whose terms become empty.
+    void Compact(const std::vector<uint8_t>& is_removed);
+
+private:
+    std::vector<uint64_t> offsets_;
+
+    std::vector<TermCount> entries_;
+
+    size_t removed_entry_count_ = 0;
+};
+
+// The words of a document with their frequencies in increasing order of term ids, read through
+// from the forward index and divided by the length of the document. Valid until the index changes.
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(std::vector<TermCount>::const_iterator entry, double inverse_length, const TermDictionary& terms)
+            : entry_(entry), inverse_length_(inverse_length), terms_(&terms)
+        {}
+
+        reference operator*() const {
+            return { terms_->GetTerm(entry_->term_id), entry_->count * inverse_length_ };
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++entry_;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        std::vector<TermCount>::const_iterator entry_;
+        double inverse_length_;
+        const TermDictionary* terms_;
+    };
+
+    WordFrequencies(ForwardIndex::TermRange entries, uint32_t document_length, const TermDictionary& terms)
+        : entries_(entries), inverse_length_(1.0 / document_length), terms_(terms)
+    {}
+
+    Iterator begin() const {
+        return Iterator(entries_.begin(), inverse_length_, terms_);
+    }
+
+    Iterator end() const {
+        return Iterator(entries_.end(), inverse_length_, terms_);
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(entries_.size());
+    }
+
+    bool empty() const {
+        return entries_.begin() == entries_.end();
+    }
+
+private:
+    ForwardIndex::TermRange entries_;
+    double inverse_length_;
+    const TermDictionary& terms_;
+};
@@ -0,0 +1,79 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <array>
+
+IndexSegment IndexSegment::Build(const std::vector<PostingList>& postings, uint32_t begin_ordinal, uint32_t end_ordinal) {
+    IndexSegment segment;
+    segment.begin_ordinal_ = begin_ordinal;
+    segment.end_ordinal_ = end_ordinal;
+
+    size_t block_count = 0;
+    size_t data_size = 0;
+    for (const PostingList& term_postings : postings) {
+        block_count += term_postings.GetBlockCount();
+        data_size += term_postings.GetView().GetDataSize();
+    }
+    segment.terms_.reserve(postings.size());
+    segment.blocks_.reserve(block_count);
+    segment.data_.reserve(data_size);
+    for (const PostingList& term_postings : postings) {
+        segment.AppendTerm(term_postings.GetView());
+    }
+    return segment;
+}
+
+IndexSegment IndexSegment::Merge(const std::vector<const IndexSegment*>& segments, const std::vector<uint8_t>& removed,
+    const std::vector<uint32_t>& document_lengths) {
+    IndexSegment segment;
+    if (segments.empty()) {
+        return segment;
+    }
+    segment.begin_ordinal_ = segments.front()->begin_ordinal_;
+    segment.end_ordinal_ = segments.back()->end_ordinal_;
+
+    size_t term_count = 0;
+    for (const IndexSegment* source : segments) {
+        term_count = std::max(term_count, source->GetTermCount());
+    }
+    segment.terms_.reserve(term_count);
+
+    // Ordinals only grow from one segment to the next, so every list is rebuilt with appends.
+    std::array<Posting, PostingListView::BLOCK_SIZE> block;
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        PostingList postings;
+        for (const IndexSegment* source : segments) {
+            const PostingListView view = source->GetPostings(term_id);
+            for (size_t block_index = 0; block_index < view.GetBlockCount(); ++block_index) {
+                const size_t count = view.DecodeBlock(block_index, block.data());
+                for (size_t i = 0; i < count; ++i) {
+                    const uint32_t index = block[i].document_id - segment.begin_ordinal_;
+                    if (!removed[index]) {
+                        postings.Insert(block[i].document_id, block[i].term_count,
+                            RoundUpTermFreq(static_cast<double>(block[i].term_count) / document_lengths[index]));
+                    }
+                }
+            }
+        }
+        segment.AppendTerm(postings.GetView());
+    }
+    return segment;
+}
+
+PostingListView IndexSegment::GetPostings(uint32_t term_id) const {
+    if (term_id >= terms_.size()) {
+        return PostingListView();
+    }
+    const Term& term = terms_[term_id];
+    return PostingListView(blocks_.data() + term.first_block, term.block_count,
+        data_.data() + term.data_offset, term.data_size, term.posting_count, term.max_term_freq);
+}
+
+void IndexSegment::AppendTerm(const PostingListView& postings) {
+    terms_.push_back({ data_.size(), static_cast<uint32_t>(postings.GetDataSize()), static_cast<uint32_t>(blocks_.size()),
+        static_cast<uint32_t>(postings.GetBlockCount()), static_cast<uint32_t>(postings.size()), postings.GetMaxTermFreq() });
+    for (size_t block_index = 0; block_index < postings.GetBlockCount(); ++block_index) {
+        blocks_.push_back(postings.GetBlockHeader(block_index));
+    }
+    data_.insert(data_.end(), postings.GetData(), postings.GetData() + postings.GetDataSize());
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "posting_list.h"
+
+// Immutable postings of the documents with ordinals in [begin ordinal, end ordinal). The posting
+// lists of all terms share one array of block headers and one byte buffer, laid out term after
+// term exactly like the posting sections of an index snapshot.
+class IndexSegment {
+public:
+    IndexSegment() = default;
+
+    // Seals the postings of a mutable segment, postings[term_id] holding the postings of a term.
+    static IndexSegment Build(const std::vector<PostingList>& postings, uint32_t begin_ordinal, uint32_t end_ordinal);
+
+    // Merges segments that cover consecutive ordinal ranges, in ordinal order. Postings of the
+    // ordinals marked in removed are dropped, document_lengths give the block bounds of the
+    // others. Both are indexed from the begin ordinal of the first segment.
+    static IndexSegment Merge(const std::vector<const IndexSegment*>& segments, const std::vector<uint8_t>& removed,
+        const std::vector<uint32_t>& document_lengths);
+
+    uint32_t GetBeginOrdinal() const {
+        return begin_ordinal_;
+    }
+
+    uint32_t GetEndOrdinal() const {
+        return end_ordinal_;
+    }
+
+    size_t GetTermCount() const {
+        return terms_.size();
+    }
+
+    // An empty view for the terms that have no postings in the segment.
+    PostingListView GetPostings(uint32_t term_id) const;
+
+private:
+    struct Term {
+        uint64_t data_offset;
+        uint32_t data_size;
+        uint32_t first_block;
+        uint32_t block_count;
+        uint32_t posting_count;
+        float max_term_freq;
+    };
+
+    std::vector<Term> terms_;
+
+    std::vector<PostingBlockHeader> blocks_;
+
+    std::vector<uint8_t> data_;
+
+    uint32_t begin_ordinal_ = 0;
+
+    uint32_t end_ordinal_ = 0;
+
+    void AppendTerm(const PostingListView& postings);
+};
@@ -0,0 +1,366 @@
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <type_traits>
+
+#include "term_dictionary.h"
+
+using namespace std::string_literals;
+
+namespace {
+    const char SNAPSHOT_MAGIC[8] = { 'S', 'S', 'N', 'A', 'P', 'I', 'D', 'X' };
+    const uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+    const uint64_t SECTION_ALIGNMENT = 8;
+
+    const uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+
+    // The records are used in place, so their layout is part of the format.
+    static_assert(sizeof(SnapshotHeader) == 280, "SnapshotHeader layout changed");
+    static_assert(sizeof(SnapshotTermSlot) == 8, "SnapshotTermSlot layout changed");
+    static_assert(sizeof(SnapshotTerm) == 32, "SnapshotTerm layout changed");
+    static_assert(sizeof(SnapshotWordCount) == 8, "SnapshotWordCount layout changed");
+    static_assert(sizeof(PostingBlockHeader) == 20, "PostingBlockHeader layout changed");
+    static_assert(sizeof(DocumentStatus) == sizeof(int32_t), "DocumentStatus must be stored as a 32-bit value");
+    static_assert(std::is_trivially_copyable_v<SnapshotHeader> && std::is_trivially_copyable_v<PostingBlockHeader>);
+
+    uint64_t RotateLeft(uint64_t value, int shift) {
+        return (value << shift) | (value >> (64 - shift));
+    }
+
+    uint64_t ComputeHeaderChecksum(const SnapshotHeader& header) {
+        SnapshotChecksum checksum;
+        checksum.Update(&header, offsetof(SnapshotHeader, header_checksum));
+        return checksum.Get();
+    }
+
+    void ThrowCorrupted(const std::string& reason) {
+        throw std::runtime_error("Corrupted index snapshot: "s + reason);
+    }
+
+    // True if offsets[0..count] do not decrease and end within a section of size records.
+    bool IsValidOffsetTable(const uint64_t* offsets, uint64_t count, uint64_t size) {
+        for (uint64_t index = 0; index < count; ++index) {
+            if (offsets[index] > offsets[index + 1]) {
+                return false;
+            }
+        }
+        return offsets[count] <= size;
+    }
+}
+
+void SnapshotChecksum::Update(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    length_ += size;
+    if (tail_size_ > 0) {
+        const size_t count = std::min(size, sizeof(tail_) - tail_size_);
+        std::memcpy(tail_ + tail_size_, in, count);
+        tail_size_ += count;
+        in += count;
+        size -= count;
+        if (tail_size_ < sizeof(tail_)) {
+            return;
+        }
+        uint64_t word;
+        std::memcpy(&word, tail_, sizeof(word));
+        Mix(word);
+        tail_size_ = 0;
+    }
+    for (; size >= sizeof(uint64_t); in += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, in, sizeof(word));
+        Mix(word);
+    }
+    std::memcpy(tail_, in, size);
+    tail_size_ = size;
+}
+
+uint64_t SnapshotChecksum::Get() const {
+    uint64_t hash = hash_;
+    if (tail_size_ > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, tail_, tail_size_);
+        hash = RotateLeft(hash + word * PRIME_2, 31) * PRIME_1;
+    }
+    hash ^= length_;
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+void SnapshotChecksum::Mix(uint64_t word) {
+    hash_ = RotateLeft(hash_ + word * PRIME_2, 31) * PRIME_1;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path), temp_path_(path + ".tmp"), out_(temp_path_, std::ios::binary | std::ios::trunc)
+{
+    if (!out_) {
+        throw std::runtime_error("Cannot create "s + temp_path_);
+    }
+    // The header is written last, once the sections and the checksum are known.
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!is_committed_) {
+        out_.close();
+        std::remove(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::BeginSection(SnapshotSectionId id) {
+    EndSection();
+    static const char padding[SECTION_ALIGNMENT] = {};
+    const uint64_t padding_size = (SECTION_ALIGNMENT - position_ % SECTION_ALIGNMENT) % SECTION_ALIGNMENT;
+    Write(padding, padding_size);
+    header_.sections[id].offset = position_;
+    current_section_ = id;
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+    checksum_.Update(data, size);
+    position_ += size;
+}
+
+void SnapshotWriter::Commit(uint32_t term_count, uint32_t term_slot_count, uint32_t ordinal_count, uint32_t document_count) {
+    EndSection();
+    std::memcpy(header_.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header_.version = SNAPSHOT_VERSION;
+    header_.byte_order_mark = SNAPSHOT_BYTE_ORDER_MARK;
+    header_.file_size = position_;
+    header_.payload_checksum = checksum_.Get();
+    header_.term_count = term_count;
+    header_.term_slot_count = term_slot_count;
+    header_.ordinal_count = ordinal_count;
+    header_.document_count = document_count;
+    header_.header_checksum = ComputeHeaderChecksum(header_);
+
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Cannot write "s + temp_path_);
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path_, path_, error);
+    if (error) {
+        throw std::runtime_error("Cannot replace "s + path_ + ": "s + error.message());
+    }
+    is_committed_ = true;
+}
+
+void SnapshotWriter::EndSection() {
+    if (current_section_ >= 0) {
+        SnapshotSection& section = header_.sections[current_section_];
+        section.size = position_ - section.offset;
+        current_section_ = -1;
+    }
+}
+
+IndexSnapshot::IndexSnapshot(const std::string& path, SnapshotVerification verification)
+    : file_(path), header_(reinterpret_cast<const SnapshotHeader*>(file_.data()))
+{
+    Validate(verification);
+}
+
+uint32_t IndexSnapshot::FindTerm(std::string_view term) const {
+    const SnapshotTermSlot* slots = GetSection<SnapshotTermSlot>(TERM_SLOTS);
+    const uint32_t hash = TermDictionary::Hash(term);
+    const size_t mask = header_->term_slot_count - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const SnapshotTermSlot& candidate = slots[slot];
+        if (candidate.term_id == TermDictionary::NO_TERM) {
+            return TermDictionary::NO_TERM;
+        }
+        if (candidate.hash == hash && GetTerm(candidate.term_id) == term) {
+            return candidate.term_id;
+        }
+    }
+}
+
+std::string_view IndexSnapshot::GetTerm(uint32_t term_id) const {
+    if (term_id >= header_->term_count) {
+        throw std::out_of_range("Not found term id");
+    }
+    const uint64_t* offsets = GetSection<uint64_t>(TERM_OFFSETS);
+    return { GetSection<char>(TERM_CHARS) + offsets[term_id], static_cast<size_t>(offsets[term_id + 1] - offsets[term_id]) };
+}
+
+bool IndexSnapshot::IsStopWord(uint32_t term_id) const {
+    return term_id < header_->term_count && GetSection<SnapshotTerm>(TERMS)[term_id].is_stop_word != 0;
+}
+
+PostingListView IndexSnapshot::GetPostings(uint32_t term_id) const {
+    const SnapshotTerm& term = GetSection<SnapshotTerm>(TERMS)[term_id];
+    return PostingListView(GetSection<PostingBlockHeader>(POSTING_BLOCKS) + term.first_block, term.block_count,
+        GetSection<uint8_t>(POSTING_DATA) + term.data_offset, term.data_size, term.posting_count, term.max_term_freq);
+}
+
+DocumentColumns IndexSnapshot::GetDocumentColumns() const {
+    return {
+        GetSection<int>(DOCUMENT_IDS),
+        GetSection<int>(DOCUMENT_RATINGS),
+        GetSection<DocumentStatus>(DOCUMENT_STATUSES),
+        GetSection<uint32_t>(DOCUMENT_LENGTHS),
+        header_->ordinal_count
+    };
+}
+
+uint32_t IndexSnapshot::GetDocumentCount() const {
+    return header_->document_count;
+}
+
+const int* IndexSnapshot::GetLiveDocumentIds() const {
+    return GetSection<int>(LIVE_DOCUMENT_IDS);
+}
+
+uint32_t IndexSnapshot::FindDocumentOrdinal(int document_id) const {
+    const int* first = GetLiveDocumentIds();
+    const int* last = first + header_->document_count;
+    const int* found = std::lower_bound(first, last, document_id);
+    if (found == last || *found != document_id) {
+        return NO_ORDINAL;
+    }
+    return GetSection<uint32_t>(LIVE_DOCUMENT_ORDINALS)[found - first];
+}
+
+const SnapshotWordCount* IndexSnapshot::GetWordCountsBegin(uint32_t ordinal) const {
+    return GetSection<SnapshotWordCount>(WORD_COUNTS) + GetSection<uint64_t>(WORD_COUNT_OFFSETS)[ordinal];
+}
+
+const SnapshotWordCount* IndexSnapshot::GetWordCountsEnd(uint32_t ordinal) const {
+    return GetSection<SnapshotWordCount>(WORD_COUNTS) + GetSection<uint64_t>(WORD_COUNT_OFFSETS)[ordinal + 1];
+}
+
+void IndexSnapshot::Validate(SnapshotVerification verification) const {
+    if (file_.size() < sizeof(SnapshotHeader) || std::memcmp(header_->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        ThrowCorrupted("not an index snapshot"s);
+    }
+    if (header_->byte_order_mark != SNAPSHOT_BYTE_ORDER_MARK) {
+        ThrowCorrupted("written with a different byte order"s);
+    }
+    if (header_->version != SNAPSHOT_VERSION) {
+        ThrowCorrupted("unsupported version "s + std::to_string(header_->version));
+    }
+    if (header_->header_checksum != ComputeHeaderChecksum(*header_)) {
+        ThrowCorrupted("header checksum mismatch"s);
+    }
+    if (header_->file_size != file_.size()) {
+        ThrowCorrupted("file size mismatch"s);
+    }
+
+    const uint64_t term_count = header_->term_count;
+    const uint64_t slot_count = header_->term_slot_count;
+    const uint64_t ordinal_count = header_->ordinal_count;
+    const uint64_t document_count = header_->document_count;
+    if (slot_count <= term_count || (slot_count & (slot_count - 1)) != 0) {
+        ThrowCorrupted("invalid term table"s);
+    }
+
+    // Sizes of the fixed-size sections, the others only need to hold whole records.
+    const uint64_t ANY_SIZE = UINT64_MAX;
+    const uint64_t expected_sizes[SECTION_COUNT] = {
+        slot_count * sizeof(SnapshotTermSlot),
+        (term_count + 1) * sizeof(uint64_t),
+        ANY_SIZE,
+        term_count * sizeof(SnapshotTerm),
+        ANY_SIZE,
+        ANY_SIZE,
+        ordinal_count * sizeof(int32_t),
+        ordinal_count * sizeof(int32_t),
+        ordinal_count * sizeof(DocumentStatus),
+        ordinal_count * sizeof(uint32_t),
+        document_count * sizeof(int32_t),
+        document_count * sizeof(uint32_t),
+        (ordinal_count + 1) * sizeof(uint64_t),
+        ANY_SIZE,
+    };
+    const uint64_t record_sizes[SECTION_COUNT] = {
+        1, 1, 1, 1, sizeof(PostingBlockHeader), 1, 1, 1, 1, 1, 1, 1, 1, sizeof(SnapshotWordCount),
+    };
+    for (uint32_t id = 0; id < SECTION_COUNT; ++id) {
+        const SnapshotSection& section = header_->sections[id];
+        if (section.offset < sizeof(SnapshotHeader) || section.offset % SECTION_ALIGNMENT != 0
+            || section.offset > file_.size() || section.size > file_.size() - section.offset
+            || (expected_sizes[id] != ANY_SIZE && section.size != expected_sizes[id]) || section.size % record_sizes[id] != 0) {
+            ThrowCorrupted("invalid section "s + std::to_string(id));
+        }
+    }
+
+    // The tables that locate records in other sections are checked in both modes, so that a
+    // damaged file is rejected here instead of being read out of bounds later.
+    const SnapshotTermSlot* slots = GetSection<SnapshotTermSlot>(TERM_SLOTS);
+    bool has_free_slot = false;
+    for (uint64_t slot = 0; slot < slot_count; ++slot) {
+        if (slots[slot].term_id == TermDictionary::NO_TERM) {
+            has_free_slot = true;
+        } else if (slots[slot].term_id >= term_count) {
+            ThrowCorrupted("invalid term slot"s);
+        }
+    }
+    // FindTerm stops at a free slot.
+    if (!has_free_slot) {
+        ThrowCorrupted("invalid term table"s);
+    }
+    if (!IsValidOffsetTable(GetSection<uint64_t>(TERM_OFFSETS), term_count, header_->sections[TERM_CHARS].size)) {
+        ThrowCorrupted("invalid term offsets"s);
+    }
+
+    const SnapshotTerm* terms = GetSection<SnapshotTerm>(TERMS);
+    const PostingBlockHeader* blocks = GetSection<PostingBlockHeader>(POSTING_BLOCKS);
+    const uint64_t total_block_count = header_->sections[POSTING_BLOCKS].size / sizeof(PostingBlockHeader);
+    const uint64_t posting_data_size = header_->sections[POSTING_DATA].size;
+    // The postings of the terms are stored back to back in term order.
+    uint64_t next_block = 0;
+    uint64_t next_data_offset = 0;
+    for (uint64_t term_id = 0; term_id < term_count; ++term_id) {
+        const SnapshotTerm& term = terms[term_id];
+        if (term.first_block != next_block || term.block_count > total_block_count - next_block
+            || term.data_offset != next_data_offset || term.data_size > posting_data_size - next_data_offset) {
+            ThrowCorrupted("invalid postings of term "s + std::to_string(term_id));
+        }
+        next_block += term.block_count;
+        next_data_offset += term.data_size;
+        // A block is decoded into a buffer of BLOCK_SIZE postings, its ordinals index the document columns.
+        for (uint32_t block = term.first_block; block < term.first_block + term.block_count; ++block) {
+            const PostingBlockHeader& header = blocks[block];
+            if (header.count == 0 || header.count > PostingListView::BLOCK_SIZE || header.offset >= term.data_size
+                || header.first_document_id > header.last_document_id || header.last_document_id >= ordinal_count) {
+                ThrowCorrupted("invalid posting block of term "s + std::to_string(term_id));
+            }
+        }
+    }
+
+    const uint32_t* live_ordinals = GetSection<uint32_t>(LIVE_DOCUMENT_ORDINALS);
+    for (uint64_t index = 0; index < document_count; ++index) {
+        if (live_ordinals[index] >= ordinal_count) {
+            ThrowCorrupted("invalid document ordinal"s);
+        }
+    }
+    const uint64_t word_count = header_->sections[WORD_COUNTS].size / sizeof(SnapshotWordCount);
+    if (!IsValidOffsetTable(GetSection<uint64_t>(WORD_COUNT_OFFSETS), ordinal_count, word_count)) {
+        ThrowCorrupted("invalid word count offsets"s);
+    }
+
+    if (verification == SnapshotVerification::FULL) {
+        SnapshotChecksum checksum;
+        checksum.Update(file_.data() + sizeof(SnapshotHeader), file_.size() - sizeof(SnapshotHeader));
+        if (checksum.Get() != header_->payload_checksum) {
+            ThrowCorrupted("payload checksum mismatch"s);
+        }
+    }
+}
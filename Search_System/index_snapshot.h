@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "document.h"
+#include "document_scorer.h"
+#include "mapped_file.h"
+#include "posting_list.h"
+
+// Binary index snapshot. The file is a fixed header followed by sections aligned to 8 bytes; every
+// section is an array of trivially copyable records that are used in place once the file is mapped.
+// Multi-byte values are stored in the byte order of the machine that wrote the file, a snapshot
+// written on a machine with a different byte order is rejected by the byte order mark.
+
+const uint32_t SNAPSHOT_VERSION = 2;
+
+enum SnapshotSectionId : uint32_t {
+    TERM_SLOTS,             // SnapshotTermSlot[term_slot_count], open-addressing table over TermDictionary::Hash
+    TERM_OFFSETS,           // uint64_t[term_count + 1], offsets of the terms in TERM_CHARS
+    TERM_CHARS,             // char[]
+    TERMS,                  // SnapshotTerm[term_count]
+    POSTING_BLOCKS,         // PostingBlockHeader[], the blocks of every term back to back
+    POSTING_DATA,           // uint8_t[], the encoded postings of every term back to back
+    DOCUMENT_IDS,           // int32_t[ordinal_count]
+    DOCUMENT_RATINGS,       // int32_t[ordinal_count]
+    DOCUMENT_STATUSES,      // DocumentStatus[ordinal_count]
+    DOCUMENT_LENGTHS,       // uint32_t[ordinal_count]
+    LIVE_DOCUMENT_IDS,      // int32_t[document_count], sorted
+    LIVE_DOCUMENT_ORDINALS, // uint32_t[document_count], the ordinals of LIVE_DOCUMENT_IDS
+    WORD_COUNT_OFFSETS,     // uint64_t[ordinal_count + 1], offsets of the documents in WORD_COUNTS
+    WORD_COUNTS,            // SnapshotWordCount[], sorted by term id within a document
+    SECTION_COUNT,
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t file_size;
+    uint64_t payload_checksum;
+    uint32_t term_count;
+    uint32_t term_slot_count;
+    uint32_t ordinal_count;
+    uint32_t document_count;
+    SnapshotSection sections[SECTION_COUNT];
+    uint64_t header_checksum;
+};
+
+struct SnapshotTermSlot {
+    uint32_t hash;
+    uint32_t term_id;
+};
+
+struct SnapshotTerm {
+    uint64_t data_offset;
+    uint32_t data_size;
+    uint32_t first_block;
+    uint32_t block_count;
+    uint32_t posting_count;
+    float max_term_freq;
+    uint32_t is_stop_word;
+};
+
+struct SnapshotWordCount {
+    uint32_t term_id;
+    uint32_t count;
+};
+
+enum class SnapshotVerification {
+    // The header and the tables that locate records are checked, the payload checksum is skipped,
+    // so startup does not read the posting data and the word counts.
+    HEADER,
+    // The checksum of the whole file is verified, which reads every page once.
+    FULL,
+};
+
+// 64-bit checksum over 8-byte words, fed in pieces of any size.
+class SnapshotChecksum {
+public:
+    void Update(const void* data, size_t size);
+
+    uint64_t Get() const;
+
+private:
+    uint64_t hash_ = 0x27D4EB2F165667C5ULL;
+    uint64_t length_ = 0;
+    uint8_t tail_[8];
+    size_t tail_size_ = 0;
+
+    void Mix(uint64_t word);
+};
+
+// Streams sections into a temporary file and moves it over path on Commit, so that a process
+// which has the previous snapshot mapped keeps a consistent file.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    // Removes the temporary file unless Commit has replaced the snapshot with it, so a write that
+    // fails or throws partway leaves nothing behind.
+    ~SnapshotWriter();
+
+    void BeginSection(SnapshotSectionId id);
+
+    void Write(const void* data, size_t size);
+
+    template <typename T>
+    void WriteSection(SnapshotSectionId id, const T* items, size_t count) {
+        BeginSection(id);
+        Write(items, count * sizeof(T));
+    }
+
+    void Commit(uint32_t term_count, uint32_t term_slot_count, uint32_t ordinal_count, uint32_t document_count);
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream out_;
+    SnapshotHeader header_{};
+    SnapshotChecksum checksum_;
+    uint64_t position_ = sizeof(SnapshotHeader);
+    int current_section_ = -1;
+    bool is_committed_ = false;
+
+    void EndSection();
+};
+
+// A validated, read-only view of a mapped snapshot file.
+class IndexSnapshot {
+public:
+    static constexpr uint32_t NO_ORDINAL = UINT32_MAX;
+
+    explicit IndexSnapshot(const std::string& path, SnapshotVerification verification = SnapshotVerification::FULL);
+
+    uint32_t FindTerm(std::string_view term) const;
+
+    std::string_view GetTerm(uint32_t term_id) const;
+
+    bool IsStopWord(uint32_t term_id) const;
+
+    PostingListView GetPostings(uint32_t term_id) const;
+
+    DocumentColumns GetDocumentColumns() const;
+
+    uint32_t GetDocumentCount() const;
+
+    const int* GetLiveDocumentIds() const;
+
+    uint32_t FindDocumentOrdinal(int document_id) const;
+
+    const SnapshotWordCount* GetWordCountsBegin(uint32_t ordinal) const;
+
+    const SnapshotWordCount* GetWordCountsEnd(uint32_t ordinal) const;
+
+private:
+    MappedFile file_;
+    const SnapshotHeader* header_;
+
+    template <typename T>
+    const T* GetSection(SnapshotSectionId id) const {
+        return reinterpret_cast<const T*>(file_.data() + header_->sections[id].offset);
+    }
+
+    void Validate(SnapshotVerification verification) const;
+};
@@ -0,0 +1,55 @@
+#include "near_duplicates.h"
+
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+MinHashBandBuilder::MinHashBandBuilder(uint32_t band, uint32_t rows_per_band)
+    : rows_per_band_(rows_per_band)
+{
+    if (rows_per_band == 0 || rows_per_band > MAX_ROWS_PER_BAND) {
+        throw std::invalid_argument("Rows per band must be from 1 to "s + std::to_string(MAX_ROWS_PER_BAND));
+    }
+    // Every row of every band gets its own hash function.
+    for (uint32_t row = 0; row < rows_per_band_; ++row) {
+        seeds_[row] = Mix(static_cast<uint64_t>(band) * MAX_ROWS_PER_BAND + row + 1);
+    }
+    minima_.fill(std::numeric_limits<uint64_t>::max());
+}
+
+uint64_t MinHashBandBuilder::GetKey() const {
+    uint64_t key = 0;
+    for (uint32_t row = 0; row < rows_per_band_; ++row) {
+        key = Mix(key ^ minima_[row]);
+    }
+    return key;
+}
+
+DocumentClusters::DocumentClusters(size_t size)
+    : parents_(size)
+{
+    std::iota(parents_.begin(), parents_.end(), 0);
+}
+
+void DocumentClusters::Unite(uint32_t index, uint32_t other_index) {
+    index = Find(index);
+    other_index = Find(other_index);
+    // The smaller index becomes the root, so a cluster is named after its first document.
+    if (index < other_index) {
+        parents_[other_index] = index;
+    }
+    else if (other_index < index) {
+        parents_[index] = other_index;
+    }
+}
+
+uint32_t DocumentClusters::Find(uint32_t index) {
+    while (parents_[index] != index) {
+        parents_[index] = parents_[parents_[index]];
+        index = parents_[index];
+    }
+    return index;
+}
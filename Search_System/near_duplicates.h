@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Documents are near duplicates when the Jaccard similarity of their sets of words is at least
+// min_jaccard. Candidates are documents whose MinHash sketches agree on every row of at least one
+// of band_count bands, a pair with similarity s becomes a candidate with probability
+// 1 - (1 - s^rows_per_band)^band_count, so more bands find more pairs and more rows fewer.
+//
+// Every candidate pair of a bucket is compared as long as the bucket holds at most
+// max_exact_bucket_size documents. In a larger bucket every document is only compared with the
+// first one, which bounds the cost of a template shared by many documents but may miss pairs of
+// that bucket that the other bands do not find either.
+struct NearDuplicateOptions {
+    double min_jaccard = 0.8;
+    uint32_t band_count = 16;
+    uint32_t rows_per_band = 4;
+    uint32_t max_exact_bucket_size = 64;
+};
+
+// Minimal hashes of the terms of a document for the rows of one band of its MinHash sketch, which
+// are combined into a key. Documents with equal keys are in the same bucket of the band.
+class MinHashBandBuilder {
+public:
+    static constexpr uint32_t MAX_ROWS_PER_BAND = 16;
+
+    MinHashBandBuilder(uint32_t band, uint32_t rows_per_band);
+
+    void Add(uint32_t term_id) {
+        const uint64_t term_hash = Mix(term_id);
+        for (uint32_t row = 0; row < rows_per_band_; ++row) {
+            uint64_t value = (term_hash ^ seeds_[row]) * 0x9e3779b97f4a7c15ull;
+            value ^= value >> 32;
+            if (value < minima_[row]) {
+                minima_[row] = value;
+            }
+        }
+    }
+
+    uint64_t GetKey() const;
+
+private:
+    uint32_t rows_per_band_;
+    std::array<uint64_t, MAX_ROWS_PER_BAND> seeds_;
+    std::array<uint64_t, MAX_ROWS_PER_BAND> minima_;
+
+    // Finalizer of splitmix64.
+    static uint64_t Mix(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+};
+
+// Disjoint sets of the indexes [0, size) that are merged pair by pair.
+class DocumentClusters {
+public:
+    explicit DocumentClusters(size_t size);
+
+    void Unite(uint32_t index, uint32_t other_index);
+
+    uint32_t Find(uint32_t index);
+
+private:
+    std::vector<uint32_t> parents_;
+};
@@ -0,0 +1,307 @@
+#include "posting_list.h"
+
+#include <algorithm>
+
+namespace {
+    void AppendVarint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    const uint8_t* ReadVarint(const uint8_t* in, uint32_t& value) {
+        // Deltas within a block and term counts almost always fit in one byte.
+        if (*in < 0x80) {
+            value = *in;
+            return in + 1;
+        }
+        uint32_t result = 0;
+        int shift = 0;
+        while (*in & 0x80) {
+            result |= static_cast<uint32_t>(*in++ & 0x7F) << shift;
+            shift += 7;
+        }
+        result |= static_cast<uint32_t>(*in++) << shift;
+        value = result;
+        return in;
+    }
+
+    bool ByDocumentId(const Posting& lhs, uint32_t document_id) {
+        return lhs.document_id < document_id;
+    }
+
+    bool ByLastDocumentId(const PostingBlockHeader& header, uint32_t document_id) {
+        return header.last_document_id < document_id;
+    }
+}
+
+PostingListView::Iterator::Iterator(const PostingListView& list, size_t block_index)
+    : list_(list), block_index_(block_index)
+{
+    LoadBlock();
+}
+
+PostingListView::Iterator& PostingListView::Iterator::operator++() {
+    if (++position_ == block_size_) {
+        ++block_index_;
+        position_ = 0;
+        LoadBlock();
+    }
+    return *this;
+}
+
+void PostingListView::Iterator::LoadBlock() {
+    block_size_ = block_index_ < list_.GetBlockCount() ? list_.DecodeBlock(block_index_, block_.data()) : 0;
+}
+
+PostingListView::Cursor::Cursor(const PostingListView& list)
+    : list_(list)
+{
+    LoadBlock(0);
+}
+
+void PostingListView::Cursor::Next() {
+    if (++position_ < block_size_) {
+        document_id_ = block_[position_].document_id;
+    }
+    else {
+        LoadBlock(block_index_ + 1);
+    }
+}
+
+void PostingListView::Cursor::NextGeq(uint32_t document_id) {
+    if (document_id <= document_id_) {
+        return;
+    }
+    if (list_.blocks_[block_index_].last_document_id < document_id) {
+        const BlockHeader* blocks_end = list_.blocks_ + list_.block_count_;
+        const BlockHeader* next_block = std::lower_bound(list_.blocks_ + block_index_ + 1, blocks_end, document_id, ByLastDocumentId);
+        LoadBlock(next_block - list_.blocks_);
+        if (document_id_ == END) {
+            return;
+        }
+    }
+    position_ = std::lower_bound(block_.data() + position_, block_.data() + block_size_, document_id, ByDocumentId) - block_.data();
+    document_id_ = block_[position_].document_id;
+}
+
+const PostingListView::BlockHeader* PostingListView::Cursor::FindBlockHeader(uint32_t document_id) const {
+    if (document_id_ == END) {
+        return nullptr;
+    }
+    if (list_.blocks_[block_index_].last_document_id >= document_id) {
+        return &list_.blocks_[block_index_];
+    }
+    const BlockHeader* blocks_end = list_.blocks_ + list_.block_count_;
+    const BlockHeader* header = std::lower_bound(list_.blocks_ + block_index_, blocks_end, document_id, ByLastDocumentId);
+    return header == blocks_end ? nullptr : header;
+}
+
+void PostingListView::Cursor::LoadBlock(size_t block_index) {
+    block_index_ = block_index;
+    position_ = 0;
+    if (block_index < list_.block_count_) {
+        block_size_ = list_.DecodeBlock(block_index, block_.data());
+        document_id_ = block_[0].document_id;
+    }
+    else {
+        block_size_ = 0;
+        document_id_ = END;
+    }
+}
+
+PostingListView::PostingListView(const BlockHeader* blocks, size_t block_count, const uint8_t* data, size_t data_size, size_t size, float max_term_freq)
+    : blocks_(blocks), block_count_(block_count), data_(data), data_size_(data_size), size_(size), max_term_freq_(max_term_freq)
+{}
+
+bool PostingListView::Contains(uint32_t document_id) const {
+    const size_t block_index = FindBlock(document_id);
+    if (block_index == block_count_ || blocks_[block_index].first_document_id > document_id) {
+        return false;
+    }
+
+    std::array<Posting, BLOCK_SIZE> postings;
+    const size_t count = DecodeBlock(block_index, postings.data());
+    const Posting* position = std::lower_bound(postings.data(), postings.data() + count, document_id, ByDocumentId);
+    return position != postings.data() + count && position->document_id == document_id;
+}
+
+PostingListView::Iterator PostingListView::begin() const {
+    return Iterator(*this, 0);
+}
+
+PostingListView::Iterator PostingListView::end() const {
+    return Iterator(*this, block_count_);
+}
+
+size_t PostingListView::DecodeBlock(size_t block_index, Posting* postings) const {
+    const BlockHeader& header = blocks_[block_index];
+    const uint8_t* in = data_ + header.offset;
+    uint32_t document_id = header.first_document_id;
+    for (uint32_t i = 0; i < header.count; ++i) {
+        if (i > 0) {
+            uint32_t delta;
+            in = ReadVarint(in, delta);
+            document_id += delta;
+        }
+        postings[i].document_id = document_id;
+        in = ReadVarint(in, postings[i].term_count);
+    }
+    return header.count;
+}
+
+size_t PostingListView::FindBlock(uint32_t document_id) const {
+    return std::lower_bound(blocks_, blocks_ + block_count_, document_id, ByLastDocumentId) - blocks_;
+}
+
+void PostingList::Insert(uint32_t document_id, uint32_t term_count, float term_freq) {
+    if (blocks_.empty() || document_id > blocks_.back().last_document_id) {
+        Append(document_id, term_count, term_freq);
+        return;
+    }
+
+    const size_t block_index = FindBlock(document_id);
+    std::array<Posting, BLOCK_SIZE + 1> postings;
+    size_t count = DecodeBlock(block_index, postings.data());
+    Posting* position = std::lower_bound(postings.data(), postings.data() + count, document_id, ByDocumentId);
+    if (position != postings.data() + count && position->document_id == document_id) {
+        position->term_count = term_count;
+    }
+    else {
+        std::copy_backward(position, postings.data() + count, postings.data() + count + 1);
+        *position = { document_id, term_count };
+        ++count;
+        ++size_;
+    }
+    ReplaceBlock(block_index, postings.data(), count, std::max(blocks_[block_index].max_term_freq, term_freq));
+}
+
+bool PostingList::Erase(uint32_t document_id) {
+    const size_t block_index = FindBlock(document_id);
+    if (block_index == blocks_.size() || blocks_[block_index].first_document_id > document_id) {
+        return false;
+    }
+
+    std::array<Posting, BLOCK_SIZE> postings;
+    const size_t count = DecodeBlock(block_index, postings.data());
+    Posting* position = std::lower_bound(postings.data(), postings.data() + count, document_id, ByDocumentId);
+    if (position == postings.data() + count || position->document_id != document_id) {
+        return false;
+    }
+    std::copy(position + 1, postings.data() + count, position);
+    --size_;
+    ReplaceBlock(block_index, postings.data(), count - 1, blocks_[block_index].max_term_freq);
+    return true;
+}
+
+bool PostingList::Contains(uint32_t document_id) const {
+    return GetView().Contains(document_id);
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+float PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+PostingList::Iterator PostingList::begin() const {
+    return GetView().begin();
+}
+
+PostingList::Iterator PostingList::end() const {
+    return GetView().end();
+}
+
+size_t PostingList::GetBlockCount() const {
+    return blocks_.size();
+}
+
+const PostingList::BlockHeader& PostingList::GetBlockHeader(size_t block_index) const {
+    return blocks_[block_index];
+}
+
+size_t PostingList::DecodeBlock(size_t block_index, Posting* postings) const {
+    return GetView().DecodeBlock(block_index, postings);
+}
+
+PostingListView PostingList::GetView() const {
+    return PostingListView(blocks_.data(), blocks_.size(), data_.data(), data_.size(), size_, max_term_freq_);
+}
+
+void PostingList::Append(uint32_t document_id, uint32_t term_count, float term_freq) {
+    if (blocks_.empty() || blocks_.back().count == BLOCK_SIZE) {
+        blocks_.push_back({ document_id, document_id, static_cast<uint32_t>(data_.size()), 1, term_freq });
+    }
+    else {
+        BlockHeader& header = blocks_.back();
+        AppendVarint(data_, document_id - header.last_document_id);
+        header.last_document_id = document_id;
+        header.max_term_freq = std::max(header.max_term_freq, term_freq);
+        ++header.count;
+    }
+    AppendVarint(data_, term_count);
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    ++size_;
+}
+
+size_t PostingList::FindBlock(uint32_t document_id) const {
+    return GetView().FindBlock(document_id);
+}
+
+size_t PostingList::GetBlockByteSize(size_t block_index) const {
+    const size_t end = block_index + 1 < blocks_.size() ? blocks_[block_index + 1].offset : data_.size();
+    return end - blocks_[block_index].offset;
+}
+
+void PostingList::ReplaceBlock(size_t block_index, const Posting* postings, size_t count, float max_term_freq) {
+    // An overfull block is split in halves so that both keep room for further inserts.
+    const size_t first_count = count > BLOCK_SIZE ? count / 2 : count;
+    const size_t offset = blocks_[block_index].offset;
+
+    std::vector<uint8_t> bytes;
+    std::vector<BlockHeader> headers;
+    const auto encode = [&](size_t begin, size_t end) {
+        if (begin == end) {
+            return;
+        }
+        headers.push_back({ postings[begin].document_id, postings[end - 1].document_id,
+            static_cast<uint32_t>(offset + bytes.size()), static_cast<uint32_t>(end - begin), max_term_freq });
+        AppendVarint(bytes, postings[begin].term_count);
+        for (size_t i = begin + 1; i < end; ++i) {
+            AppendVarint(bytes, postings[i].document_id - postings[i - 1].document_id);
+            AppendVarint(bytes, postings[i].term_count);
+        }
+    };
+    encode(0, first_count);
+    encode(first_count, count);
+
+    const size_t old_size = GetBlockByteSize(block_index);
+    const auto first = data_.begin() + offset;
+    if (bytes.size() >= old_size) {
+        std::copy(bytes.begin(), bytes.begin() + old_size, first);
+        data_.insert(first + old_size, bytes.begin() + old_size, bytes.end());
+    }
+    else {
+        std::copy(bytes.begin(), bytes.end(), first);
+        data_.erase(first + bytes.size(), first + old_size);
+    }
+
+    blocks_.erase(blocks_.begin() + block_index);
+    blocks_.insert(blocks_.begin() + block_index, headers.begin(), headers.end());
+    for (size_t i = block_index + headers.size(); i < blocks_.size(); ++i) {
+        blocks_[i].offset = static_cast<uint32_t>(blocks_[i].offset + bytes.size() - old_size);
+    }
+
+    max_term_freq_ = 0;
+    for (const BlockHeader& header : blocks_) {
+        max_term_freq_ = std::max(max_term_freq_, header.max_term_freq);
+    }
+}
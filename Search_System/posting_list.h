@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+// The term frequency of a posting is term_count divided by the length of its document, which the
+// posting list does not know. Block headers keep an upper bound of the frequencies for pruning.
+struct Posting {
+    uint32_t document_id;
+    uint32_t term_count;
+};
+
+struct PostingBlockHeader {
+    uint32_t first_document_id;
+    uint32_t last_document_id;
+    uint32_t offset;
+    uint32_t count;
+    float max_term_freq;
+};
+
+// Read-only view of an encoded posting list. It does not own the block headers and bytes, which
+// belong either to a PostingList or to a memory-mapped index snapshot.
+class PostingListView {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    using BlockHeader = PostingBlockHeader;
+
+    class Iterator;
+
+    class Cursor;
+
+    PostingListView() = default;
+
+    PostingListView(const BlockHeader* blocks, size_t block_count, const uint8_t* data, size_t data_size, size_t size, float max_term_freq);
+
+    bool Contains(uint32_t document_id) const;
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    float GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t GetBlockCount() const {
+        return block_count_;
+    }
+
+    const BlockHeader& GetBlockHeader(size_t block_index) const {
+        return blocks_[block_index];
+    }
+
+    const uint8_t* GetData() const {
+        return data_;
+    }
+
+    size_t GetDataSize() const {
+        return data_size_;
+    }
+
+    size_t DecodeBlock(size_t block_index, Posting* postings) const;
+
+    size_t FindBlock(uint32_t document_id) const;
+
+    template <typename Callback>
+    void ForEachBlock(uint32_t begin_document_id, uint32_t end_document_id, Callback callback) const;
+
+private:
+    const BlockHeader* blocks_ = nullptr;
+    size_t block_count_ = 0;
+    const uint8_t* data_ = nullptr;
+    size_t data_size_ = 0;
+    size_t size_ = 0;
+    float max_term_freq_ = 0;
+};
+
+class PostingListView::Iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Posting;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Posting*;
+    using reference = const Posting&;
+
+    Iterator(const PostingListView& list, size_t block_index);
+
+    const Posting& operator*() const {
+        return block_[position_];
+    }
+
+    const Posting* operator->() const {
+        return &block_[position_];
+    }
+
+    Iterator& operator++();
+
+    bool operator==(const Iterator& other) const {
+        return block_index_ == other.block_index_ && position_ == other.position_;
+    }
+
+    bool operator!=(const Iterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    PostingListView list_;
+    size_t block_index_;
+    size_t position_ = 0;
+    size_t block_size_ = 0;
+    std::array<Posting, BLOCK_SIZE> block_;
+
+    void LoadBlock();
+};
+
+// Document-at-a-time cursor. It can skip forward to a target id using the block headers and
+// report the block maximum of a later block without decoding it.
+class PostingListView::Cursor {
+public:
+    static constexpr uint32_t END = UINT32_MAX;
+
+    explicit Cursor(const PostingListView& list);
+
+    uint32_t GetDocumentId() const {
+        return document_id_;
+    }
+
+    uint32_t GetTermCount() const {
+        return block_[position_].term_count;
+    }
+
+    void Next();
+
+    void NextGeq(uint32_t document_id);
+
+    const BlockHeader* FindBlockHeader(uint32_t document_id) const;
+
+private:
+    PostingListView list_;
+    size_t block_index_ = 0;
+    size_t position_ = 0;
+    size_t block_size_ = 0;
+    uint32_t document_id_ = END;
+    std::array<Posting, BLOCK_SIZE> block_;
+
+    void LoadBlock(size_t block_index);
+};
+
+// The smallest float that is not less than term_freq, so that bounds kept as floats never
+// undercut a frequency computed in double.
+inline float RoundUpTermFreq(double term_freq) {
+    const float rounded = static_cast<float>(term_freq);
+    return rounded < term_freq ? std::nextafter(rounded, std::numeric_limits<float>::infinity()) : rounded;
+}
+
+// Postings of one term sorted by document id. They are grouped into blocks of up to BLOCK_SIZE
+// entries stored back to back in one byte buffer: the first posting of a block keeps its id in the
+// block header, every next one is written as a varint delta, each followed by its term count as a
+// varint, which takes one byte for counts below 128.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = PostingListView::BLOCK_SIZE;
+
+    using BlockHeader = PostingBlockHeader;
+    using Iterator = PostingListView::Iterator;
+    using Cursor = PostingListView::Cursor;
+
+    // term_freq is the frequency of the term in the document, it only raises the block bound.
+    void Insert(uint32_t document_id, uint32_t term_count, float term_freq);
+
+    bool Erase(uint32_t document_id);
+
+    bool Contains(uint32_t document_id) const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    float GetMaxTermFreq() const;
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t GetBlockCount() const;
+
+    const BlockHeader& GetBlockHeader(size_t block_index) const;
+
+    size_t DecodeBlock(size_t block_index, Posting* postings) const;
+
+    size_t FindBlock(uint32_t document_id) const;
+
+    template <typename Callback>
+    void ForEachBlock(uint32_t begin_document_id, uint32_t end_document_id, Callback callback) const {
+        GetView().ForEachBlock(begin_document_id, end_document_id, callback);
+    }
+
+    // The view is invalidated by the next Insert or Erase.
+    PostingListView GetView() const;
+
+private:
+    std::vector<BlockHeader> blocks_;
+
+    std::vector<uint8_t> data_;
+
+    size_t size_ = 0;
+
+    float max_term_freq_ = 0;
+
+    void Append(uint32_t document_id, uint32_t term_count, float term_freq);
+
+    size_t GetBlockByteSize(size_t block_index) const;
+
+    // The frequencies of the postings are unknown here, so the new blocks inherit max_term_freq
+    // as their bound.
+    void ReplaceBlock(size_t block_index, const Posting* postings, size_t count, float max_term_freq);
+};
+
+// Calls callback(postings, count) for every decoded block restricted to ids in [begin_document_id, end_document_id).
+template <typename Callback>
+void PostingListView::ForEachBlock(uint32_t begin_document_id, uint32_t end_document_id, Callback callback) const {
+    const auto by_document_id = [](const Posting& posting, uint32_t document_id) {
+        return posting.document_id < document_id;
+    };
+
+    std::array<Posting, BLOCK_SIZE> block;
+    for (size_t block_index = FindBlock(begin_document_id);
+        block_index < block_count_ && blocks_[block_index].first_document_id < end_document_id; ++block_index) {
+        const Posting* first = block.data();
+        const Posting* last = first + DecodeBlock(block_index, block.data());
+        if (first->document_id < begin_document_id) {
+            first = std::lower_bound(first, last, begin_document_id, by_document_id);
+        }
+        if ((last - 1)->document_id >= end_document_id) {
+            last = std::lower_bound(first, last, end_document_id, by_document_id);
+        }
+        callback(first, static_cast<size_t>(last - first));
+    }
+}
@@ -1,27 +1,126 @@
 #include "process_queries.h"
 
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+    ThreadPool& GetDefaultThreadPool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // Searches the queries in [first, last) and appends their documents to output in query order.
+    // The output grows once to its final size and every query then moves its documents to an
+    // offset found by a prefix sum over the result counts, so no document is copied twice.
+    void AppendJoinedResults(const SearchServer& search_server, std::vector<std::string>::const_iterator first,
+        std::vector<std::string>::const_iterator last, ThreadPool& pool, std::vector<Document>& output) {
+        std::vector<std::vector<Document>> results = search_server.FindTopDocumentsBatch(first, last, pool);
+
+        std::vector<size_t> offsets(results.size() + 1);
+        offsets[0] = output.size();
+        for (size_t index = 0; index < results.size(); ++index) {
+            offsets[index + 1] = offsets[index] + results[index].size();
+        }
+        output.resize(offsets.back());
+
+        // A task per block of queries, per query would cost more in scheduling than in moving.
+        const size_t block_count = std::min(results.size(), pool.GetThreadCount() * 4);
+        pool.ParallelFor(block_count, [&](size_t block) {
+            const size_t block_begin = block * results.size() / block_count;
+            const size_t block_end = (block + 1) * results.size() / block_count;
+            for (size_t index = block_begin; index < block_end; ++index) {
+                std::move(results[index].begin(), results[index].end(), output.begin() + offsets[index]);
+            }
+            });
+    }
+}
+
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result(queries.size());
+    return ProcessQueries(search_server, queries, GetDefaultThreadPool());
+}
 
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](auto querie) {return search_server.FindTopDocuments(querie); });
-    return result;
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
+    return search_server.FindTopDocumentsBatch(queries, pool);
 }
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> vec_vec_doc(queries.size());
+    return ProcessQueriesJoined(search_server, queries, GetDefaultThreadPool());
+}
+
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
     std::vector<Document> documents;
+    for (size_t chunk_begin = 0; chunk_begin < queries.size(); chunk_begin += QUERY_CHUNK_SIZE) {
+        const size_t chunk_end = std::min(queries.size(), chunk_begin + QUERY_CHUNK_SIZE);
+        AppendJoinedResults(search_server, queries.begin() + chunk_begin, queries.begin() + chunk_end, pool, documents);
+    }
+    return documents;
+}
 
+JoinedQueryResults::Iterator::Iterator(JoinedQueryResults* results)
+    : results_(results)
+{}
 
-    std::transform(std::execution::par, queries.begin(), queries.end(), vec_vec_doc.begin(), [&search_server](auto querie) {return search_server.FindTopDocuments(querie); });
+JoinedQueryResults::Iterator::reference JoinedQueryResults::Iterator::operator*() const {
+    return results_->chunk_documents_[index_];
+}
 
-    auto merge_function = [&vec_vec_doc](auto&& vec1, auto&& vec2) -> std::vector<Document>
-    {
-        vec1.resize(vec1.size() + vec2.size());
-        std::move(vec2.begin(), vec2.end(), vec1.end() - vec2.size());
-        return std::move(vec1);
-    };
+JoinedQueryResults::Iterator::pointer JoinedQueryResults::Iterator::operator->() const {
+    return &results_->chunk_documents_[index_];
+}
 
-    documents = std::reduce(std::execution::par, vec_vec_doc.begin(), vec_vec_doc.end(), std::vector<Document>{}, merge_function);
+JoinedQueryResults::Iterator& JoinedQueryResults::Iterator::operator++() {
+    if (++index_ == results_->chunk_documents_.size()) {
+        index_ = 0;
+        if (!results_->LoadNextChunk()) {
+            results_ = nullptr;
+        }
+    }
+    return *this;
+}
 
-    return documents;
-}
\ No newline at end of file
+void JoinedQueryResults::Iterator::operator++(int) {
+    ++*this;
+}
+
+bool JoinedQueryResults::Iterator::operator==(const Iterator& other) const {
+    return results_ == other.results_ && index_ == other.index_;
+}
+
+bool JoinedQueryResults::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
+
+JoinedQueryResults::JoinedQueryResults(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool, size_t chunk_size)
+    : search_server_(search_server), queries_(queries), pool_(pool), chunk_size_(chunk_size)
+{
+    if (chunk_size_ == 0) {
+        throw std::invalid_argument("Query chunk size must be positive"s);
+    }
+}
+
+JoinedQueryResults::Iterator JoinedQueryResults::begin() {
+    if (next_query_ == 0) {
+        LoadNextChunk();
+    }
+    return chunk_documents_.empty() ? end() : Iterator(this);
+}
+
+JoinedQueryResults::Iterator JoinedQueryResults::end() {
+    return Iterator();
+}
+
+bool JoinedQueryResults::LoadNextChunk() {
+    chunk_documents_.clear();
+    while (chunk_documents_.empty() && next_query_ < queries_.size()) {
+        const size_t chunk_end = std::min(queries_.size(), next_query_ + chunk_size_);
+        AppendJoinedResults(search_server_, queries_.begin() + next_query_, queries_.begin() + chunk_end, pool_, chunk_documents_);
+        next_query_ = chunk_end;
+    }
+    return !chunk_documents_.empty();
+}
+
+JoinedQueryResults ProcessQueriesLazy(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
+    return JoinedQueryResults(search_server, queries, pool);
+}
@@ -1,14 +1,82 @@
 #pragma once
 
+#include <cstddef>
+#include <iterator>
 #include <vector>
 #include <string>
-#include <execution>
-#include <numeric>
-#include <list>
 
 #include "document.h"
 #include "search_server.h"
+#include "thread_pool.h"
 
+// Queries are searched this many at a time when the results are joined, which bounds the memory
+// held by per-query result vectors however many queries there are.
+const size_t QUERY_CHUNK_SIZE = 4096;
+
+// Runs on a pool shared by all callers that has a thread per hardware thread.
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool);
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// Documents of all queries in query order, written straight to their place in one output buffer.
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool);
+
+// Single-pass range over the same documents as ProcessQueriesJoined. Queries are searched a chunk
+// at a time when the documents of the previous chunk are used up, so only one chunk of results is
+// held at once. The server, queries and pool must outlive the range.
+class JoinedQueryResults {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator() = default;
+
+        reference operator*() const;
+
+        pointer operator->() const;
+
+        Iterator& operator++();
+
+        void operator++(int);
+
+        bool operator==(const Iterator& other) const;
+
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        friend class JoinedQueryResults;
+
+        // Null at the end of the range.
+        JoinedQueryResults* results_ = nullptr;
+        size_t index_ = 0;
+
+        explicit Iterator(JoinedQueryResults* results);
+    };
+
+    JoinedQueryResults(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool, size_t chunk_size = QUERY_CHUNK_SIZE);
+
+    Iterator begin();
+
+    Iterator end();
+
+private:
+    const SearchServer& search_server_;
+    const std::vector<std::string>& queries_;
+    ThreadPool& pool_;
+    size_t chunk_size_;
+    size_t next_query_ = 0;
+    std::vector<Document> chunk_documents_;
+
+    // Replaces the buffer with the documents of the next chunks up to the first one that has any,
+    // returns false when the queries have run out.
+    bool LoadNextChunk();
+};
+
+JoinedQueryResults ProcessQueriesLazy(const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool);
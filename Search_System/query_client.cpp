@@ -0,0 +1,297 @@
+#include "query_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+#ifdef _WIN32
+
+int OpenTcp(const std::string& address, uint16_t port) {
+    throw std::runtime_error("QueryClient is not supported on this platform"s);
+}
+
+int OpenUnix(const std::string& path) {
+    throw std::runtime_error("QueryClient is not supported on this platform"s);
+}
+
+void SendAll(int fd, const uint8_t* data, size_t size) {
+}
+
+size_t ReceiveSome(int fd, uint8_t* data, size_t size) {
+    return 0;
+}
+
+void CloseSocket(int fd) {
+}
+
+#else
+
+std::runtime_error SystemError(const std::string& what) {
+    return std::runtime_error(what + ": "s + std::strerror(errno));
+}
+
+int Connect(int socket_fd, const sockaddr* address, socklen_t address_size, const std::string& name) {
+    if (socket_fd < 0) {
+        throw SystemError("Cannot create a socket for "s + name);
+    }
+    if (connect(socket_fd, address, address_size) != 0) {
+        const std::runtime_error error = SystemError("Cannot connect to "s + name);
+        close(socket_fd);
+        throw error;
+    }
+    return socket_fd;
+}
+
+int OpenTcp(const std::string& address, uint16_t port) {
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+        throw std::invalid_argument("Invalid IPv4 address "s + address);
+    }
+    const int fd = Connect(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0), reinterpret_cast<const sockaddr*>(&socket_address),
+        sizeof(socket_address), address + ":"s + std::to_string(port));
+    // Pipelined requests are flushed in one write, one request at a time must not wait for an ACK.
+    const int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    return fd;
+}
+
+int OpenUnix(const std::string& path) {
+    sockaddr_un socket_address{};
+    socket_address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(socket_address.sun_path)) {
+        throw std::invalid_argument("Unix socket path is too long: "s + path);
+    }
+    std::memcpy(socket_address.sun_path, path.data(), path.size());
+    return Connect(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), reinterpret_cast<const sockaddr*>(&socket_address),
+        sizeof(socket_address), path);
+}
+
+void SendAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        const ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw SystemError("send"s);
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+size_t ReceiveSome(int fd, uint8_t* data, size_t size) {
+    while (true) {
+        const ssize_t received = recv(fd, data, size, 0);
+        if (received >= 0) {
+            return static_cast<size_t>(received);
+        }
+        if (errno != EINTR) {
+            throw SystemError("recv"s);
+        }
+    }
+}
+
+void CloseSocket(int fd) {
+    close(fd);
+}
+
+#endif
+
+const size_t RECEIVE_CHUNK_SIZE = 64 * 1024;
+
+} // namespace
+
+QueryClient QueryClient::ConnectTcp(const std::string& address, uint16_t port) {
+    return QueryClient(OpenTcp(address, port));
+}
+
+QueryClient QueryClient::ConnectUnix(const std::string& path) {
+    return QueryClient(OpenUnix(path));
+}
+
+QueryClient::QueryClient(QueryClient&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)), output_(std::move(other.output_)), input_(std::move(other.input_)),
+    parsed_size_(std::exchange(other.parsed_size_, 0))
+{}
+
+QueryClient& QueryClient::operator=(QueryClient&& other) noexcept {
+    if (this != &other) {
+        if (fd_ >= 0) {
+            CloseSocket(fd_);
+        }
+        fd_ = std::exchange(other.fd_, -1);
+        output_ = std::move(other.output_);
+        input_ = std::move(other.input_);
+        parsed_size_ = std::exchange(other.parsed_size_, 0);
+    }
+    return *this;
+}
+
+QueryClient::~QueryClient() {
+    if (fd_ >= 0) {
+        CloseSocket(fd_);
+    }
+}
+
+void QueryClient::SendFindTopDocuments(std::string_view raw_query, DocumentStatus status) {
+    WriteFindTopDocumentsRequest(output_, raw_query, status);
+}
+
+void QueryClient::SendMatchDocument(std::string_view raw_query, int document_id) {
+    WriteMatchDocumentRequest(output_, raw_query, document_id);
+}
+
+void QueryClient::SendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    WriteAddDocumentRequest(output_, document_id, document, status, ratings);
+}
+
+void QueryClient::SendRemoveDocument(int document_id) {
+    WriteRemoveDocumentRequest(output_, document_id);
+}
+
+void QueryClient::Flush() {
+    if (output_.empty()) {
+        return;
+    }
+    SendAll(fd_, output_.data(), output_.size());
+    output_.clear();
+}
+
+std::vector<Document> QueryClient::ReceiveDocuments() {
+    return ParseDocumentsResponse(ReceiveFrame());
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> QueryClient::ReceiveMatch() {
+    std::vector<std::string> words;
+    DocumentStatus status;
+    ParseMatchResponse(ReceiveFrame(), words, status);
+    return { std::move(words), status };
+}
+
+void QueryClient::ReceiveEmpty() {
+    ParseEmptyResponse(ReceiveFrame());
+}
+
+std::vector<Document> QueryClient::FindTopDocuments(std::string_view raw_query, DocumentStatus status) {
+    SendFindTopDocuments(raw_query, status);
+    return ReceiveDocuments();
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> QueryClient::MatchDocument(std::string_view raw_query, int document_id) {
+    SendMatchDocument(raw_query, document_id);
+    return ReceiveMatch();
+}
+
+void QueryClient::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    SendAddDocument(document_id, document, status, ratings);
+    ReceiveEmpty();
+}
+
+void QueryClient::RemoveDocument(int document_id) {
+    SendRemoveDocument(document_id);
+    ReceiveEmpty();
+}
+
+Frame QueryClient::ReceiveFrame() {
+    Flush();
+    while (true) {
+        Frame frame;
+        const FrameStatus status = ReadFrame(input_.data() + parsed_size_, input_.size() - parsed_size_, frame);
+        if (status == FrameStatus::COMPLETE) {
+            parsed_size_ += FRAME_HEADER_SIZE + frame.payload_size;
+            return frame;
+        }
+        if (status == FrameStatus::TOO_LARGE) {
+            throw std::runtime_error("malformed response"s);
+        }
+        // The frames before parsed_size_ have been returned and parsed already.
+        input_.erase(input_.begin(), input_.begin() + parsed_size_);
+        parsed_size_ = 0;
+        const size_t old_size = input_.size();
+        input_.resize(old_size + RECEIVE_CHUNK_SIZE);
+        const size_t received = ReceiveSome(fd_, input_.data() + old_size, RECEIVE_CHUNK_SIZE);
+        input_.resize(old_size + received);
+        if (received == 0) {
+            throw std::runtime_error("connection closed by the server"s);
+        }
+    }
+}
+
+RequestStats RunQueryLoad(const std::function<QueryClient()>& connect, const std::vector<std::string>& queries, const QueryLoadOptions& options) {
+    if (queries.empty()) {
+        return {};
+    }
+    std::vector<RequestStats> connection_stats(options.connection_count);
+    std::vector<std::exception_ptr> errors(options.connection_count);
+    std::vector<std::thread> threads;
+    threads.reserve(options.connection_count);
+    for (size_t connection_index = 0; connection_index < options.connection_count; ++connection_index) {
+        threads.emplace_back([&, connection_index]() {
+            try {
+                QueryClient client = connect();
+                RequestStats& stats = connection_stats[connection_index];
+                const size_t first_query = connection_index * queries.size() / options.connection_count;
+                const size_t pipeline_depth = std::max<size_t>(options.pipeline_depth, 1);
+                std::deque<std::chrono::steady_clock::time_point> send_times;
+                const auto start = std::chrono::steady_clock::now();
+                size_t sent_count = 0;
+                while (stats.request_count < options.requests_per_connection) {
+                    while (sent_count < options.requests_per_connection && send_times.size() < pipeline_depth) {
+                        client.SendFindTopDocuments(queries[(first_query + sent_count) % queries.size()]);
+                        send_times.push_back(std::chrono::steady_clock::now());
+                        ++sent_count;
+                    }
+                    const std::vector<Document> documents = client.ReceiveDocuments();
+                    const auto now = std::chrono::steady_clock::now();
+                    stats.latencies.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(now - send_times.front()).count());
+                    send_times.pop_front();
+                    ++stats.request_count;
+                    stats.no_result_count += documents.empty() ? 1 : 0;
+                    stats.document_count += documents.size();
+                }
+                const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+                if (duration.count() > 0) {
+                    stats.queries_per_second = stats.request_count / duration.count();
+                }
+            } catch (...) {
+                errors[connection_index] = std::current_exception();
+            }
+            });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    RequestStats stats;
+    for (const RequestStats& other : connection_stats) {
+        stats.Merge(other);
+    }
+    return stats;
+}
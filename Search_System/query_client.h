@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "query_protocol.h"
+#include "request_queue.h"
+
+// Blocking client of QueryService. Requests may be pipelined: the Send methods only queue a
+// request, Flush sends everything queued and the Receive methods read the responses in the order
+// of the requests, flushing first. The Receive methods and the one-request calls rethrow the
+// invalid_argument and out_of_range errors of the server, other failures throw runtime_error.
+//
+// The server stops reading a connection whose responses are not being read, so a client should
+// keep the number of requests in flight bounded.
+class QueryClient {
+public:
+    static QueryClient ConnectTcp(const std::string& address, uint16_t port);
+
+    static QueryClient ConnectUnix(const std::string& path);
+
+    QueryClient(QueryClient&& other) noexcept;
+
+    QueryClient& operator=(QueryClient&& other) noexcept;
+
+    QueryClient(const QueryClient&) = delete;
+
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    ~QueryClient();
+
+    void SendFindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    void SendMatchDocument(std::string_view raw_query, int document_id);
+
+    void SendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void SendRemoveDocument(int document_id);
+
+    void Flush();
+
+    std::vector<Document> ReceiveDocuments();
+
+    std::tuple<std::vector<std::string>, DocumentStatus> ReceiveMatch();
+
+    // The response to an AddDocument or RemoveDocument.
+    void ReceiveEmpty();
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+private:
+    explicit QueryClient(int fd)
+        : fd_(fd)
+    {}
+
+    int fd_ = -1;
+    std::vector<uint8_t> output_;
+    std::vector<uint8_t> input_;
+    size_t parsed_size_ = 0;
+
+    // The frame points into input_ and stays valid until the next call.
+    Frame ReceiveFrame();
+};
+
+struct QueryLoadOptions {
+    size_t connection_count = 4;
+    size_t requests_per_connection = 10'000;
+    // The most queries a connection has sent without having read their responses.
+    size_t pipeline_depth = 16;
+};
+
+// Load generator: every connection runs on a thread of its own and sends the queries round-robin,
+// each connection starting at a different one. The latency of a request is measured from queueing
+// it to reading its response, queries_per_second is the sum over the connections.
+RequestStats RunQueryLoad(const std::function<QueryClient()>& connect, const std::vector<std::string>& queries, const QueryLoadOptions& options);
@@ -0,0 +1,289 @@
+#include "query_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+uint32_t LoadUint32(const uint8_t* data) {
+    return uint32_t{ data[0] } | uint32_t{ data[1] } << 8 | uint32_t{ data[2] } << 16 | uint32_t{ data[3] } << 24;
+}
+
+bool IsValidStatus(uint8_t status) {
+    return status <= static_cast<uint8_t>(DocumentStatus::REMOVED);
+}
+
+// Rethrows an error response and checks that an OK one is not truncated.
+PayloadReader CheckResponse(const Frame& frame) {
+    PayloadReader reader(frame);
+    switch (static_cast<ResponseCode>(frame.type)) {
+    case ResponseCode::OK:
+        return reader;
+    case ResponseCode::INVALID_ARGUMENT:
+        throw std::invalid_argument(std::string(reader.GetString()));
+    case ResponseCode::OUT_OF_RANGE:
+        throw std::out_of_range(std::string(reader.GetString()));
+    default:
+        throw std::runtime_error("server error: "s + std::string(reader.GetString()));
+    }
+}
+
+void CheckComplete(const PayloadReader& reader) {
+    if (!reader.IsComplete()) {
+        throw std::runtime_error("malformed response"s);
+    }
+}
+
+} // namespace
+
+FrameStatus ReadFrame(const uint8_t* data, size_t size, Frame& frame) {
+    if (size < FRAME_HEADER_SIZE) {
+        return FrameStatus::INCOMPLETE;
+    }
+    const uint32_t payload_size = LoadUint32(data);
+    if (payload_size > MAX_FRAME_PAYLOAD_SIZE) {
+        return FrameStatus::TOO_LARGE;
+    }
+    if (size - FRAME_HEADER_SIZE < payload_size) {
+        return FrameStatus::INCOMPLETE;
+    }
+    frame.type = data[4];
+    frame.payload = data + FRAME_HEADER_SIZE;
+    frame.payload_size = payload_size;
+    return FrameStatus::COMPLETE;
+}
+
+bool ParseRequest(const Frame& frame, Request& request) {
+    PayloadReader reader(frame);
+    request.type = static_cast<RequestType>(frame.type);
+    request.ratings.clear();
+    uint8_t status = 0;
+    switch (request.type) {
+    case RequestType::FIND_TOP_DOCUMENTS:
+        status = reader.GetUint8();
+        request.text = reader.GetString();
+        break;
+    case RequestType::MATCH_DOCUMENT:
+        request.document_id = reader.GetInt32();
+        request.text = reader.GetString();
+        break;
+    case RequestType::ADD_DOCUMENT: {
+        request.document_id = reader.GetInt32();
+        status = reader.GetUint8();
+        const uint32_t rating_count = reader.GetUint32();
+        // A forged count must not reserve more than the payload can hold.
+        if (rating_count > frame.payload_size / sizeof(int32_t)) {
+            return false;
+        }
+        request.ratings.reserve(rating_count);
+        for (uint32_t i = 0; i < rating_count; ++i) {
+            request.ratings.push_back(reader.GetInt32());
+        }
+        request.text = reader.GetString();
+        break;
+    }
+    case RequestType::REMOVE_DOCUMENT:
+        request.document_id = reader.GetInt32();
+        break;
+    default:
+        return false;
+    }
+    if (!IsValidStatus(status)) {
+        return false;
+    }
+    request.status = static_cast<DocumentStatus>(status);
+    return reader.IsComplete();
+}
+
+void FrameWriter::BeginFrame(uint8_t type) {
+    frame_begin_ = out_.size();
+    out_.resize(out_.size() + FRAME_HEADER_SIZE - 1);
+    out_.push_back(type);
+}
+
+void FrameWriter::EndFrame() {
+    const uint32_t payload_size = static_cast<uint32_t>(out_.size() - frame_begin_ - FRAME_HEADER_SIZE);
+    for (size_t i = 0; i < 4; ++i) {
+        out_[frame_begin_ + i] = static_cast<uint8_t>(payload_size >> (8 * i));
+    }
+}
+
+void FrameWriter::PutUint8(uint8_t value) {
+    out_.push_back(value);
+}
+
+void FrameWriter::PutUint32(uint32_t value) {
+    for (size_t i = 0; i < 4; ++i) {
+        out_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void FrameWriter::PutInt32(int32_t value) {
+    PutUint32(static_cast<uint32_t>(value));
+}
+
+void FrameWriter::PutDouble(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    PutUint32(static_cast<uint32_t>(bits));
+    PutUint32(static_cast<uint32_t>(bits >> 32));
+}
+
+void FrameWriter::PutString(std::string_view value) {
+    PutUint32(static_cast<uint32_t>(value.size()));
+    out_.insert(out_.end(), value.begin(), value.end());
+}
+
+uint8_t PayloadReader::GetUint8() {
+    const uint8_t* data = Take(1);
+    return data == nullptr ? 0 : data[0];
+}
+
+uint32_t PayloadReader::GetUint32() {
+    const uint8_t* data = Take(4);
+    return data == nullptr ? 0 : LoadUint32(data);
+}
+
+int32_t PayloadReader::GetInt32() {
+    return static_cast<int32_t>(GetUint32());
+}
+
+double PayloadReader::GetDouble() {
+    const uint64_t low = GetUint32();
+    const uint64_t bits = low | uint64_t{ GetUint32() } << 32;
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string_view PayloadReader::GetString() {
+    const uint32_t size = GetUint32();
+    const uint8_t* data = Take(size);
+    return data == nullptr ? std::string_view() : std::string_view(reinterpret_cast<const char*>(data), size);
+}
+
+bool PayloadReader::IsComplete() const {
+    return is_valid_ && position_ == end_;
+}
+
+const uint8_t* PayloadReader::Take(size_t size) {
+    if (!is_valid_ || static_cast<size_t>(end_ - position_) < size) {
+        is_valid_ = false;
+        return nullptr;
+    }
+    const uint8_t* data = position_;
+    position_ += size;
+    return data;
+}
+
+void WriteFindTopDocumentsRequest(std::vector<uint8_t>& out, std::string_view query, DocumentStatus status) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(RequestType::FIND_TOP_DOCUMENTS));
+    writer.PutUint8(static_cast<uint8_t>(status));
+    writer.PutString(query);
+    writer.EndFrame();
+}
+
+void WriteMatchDocumentRequest(std::vector<uint8_t>& out, std::string_view query, int document_id) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(RequestType::MATCH_DOCUMENT));
+    writer.PutInt32(document_id);
+    writer.PutString(query);
+    writer.EndFrame();
+}
+
+void WriteAddDocumentRequest(std::vector<uint8_t>& out, int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(RequestType::ADD_DOCUMENT));
+    writer.PutInt32(document_id);
+    writer.PutUint8(static_cast<uint8_t>(status));
+    writer.PutUint32(static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        writer.PutInt32(rating);
+    }
+    writer.PutString(document);
+    writer.EndFrame();
+}
+
+void WriteRemoveDocumentRequest(std::vector<uint8_t>& out, int document_id) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(RequestType::REMOVE_DOCUMENT));
+    writer.PutInt32(document_id);
+    writer.EndFrame();
+}
+
+void WriteDocumentsResponse(std::vector<uint8_t>& out, const std::vector<Document>& documents) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(ResponseCode::OK));
+    writer.PutUint32(static_cast<uint32_t>(documents.size()));
+    for (const Document& document : documents) {
+        writer.PutInt32(document.id);
+        writer.PutDouble(document.relevance);
+        writer.PutInt32(document.rating);
+    }
+    writer.EndFrame();
+}
+
+void WriteMatchResponse(std::vector<uint8_t>& out, const std::vector<std::string_view>& words, DocumentStatus status) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(ResponseCode::OK));
+    writer.PutUint8(static_cast<uint8_t>(status));
+    writer.PutUint32(static_cast<uint32_t>(words.size()));
+    for (const std::string_view word : words) {
+        writer.PutString(word);
+    }
+    writer.EndFrame();
+}
+
+void WriteEmptyResponse(std::vector<uint8_t>& out) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(ResponseCode::OK));
+    writer.EndFrame();
+}
+
+void WriteErrorResponse(std::vector<uint8_t>& out, ResponseCode code, std::string_view message) {
+    FrameWriter writer(out);
+    writer.BeginFrame(static_cast<uint8_t>(code));
+    writer.PutString(message);
+    writer.EndFrame();
+}
+
+std::vector<Document> ParseDocumentsResponse(const Frame& frame) {
+    PayloadReader reader = CheckResponse(frame);
+    const uint32_t document_count = reader.GetUint32();
+    if (document_count > frame.payload_size / 16) {
+        throw std::runtime_error("malformed response"s);
+    }
+    std::vector<Document> documents;
+    documents.reserve(document_count);
+    for (uint32_t i = 0; i < document_count; ++i) {
+        const int id = reader.GetInt32();
+        const double relevance = reader.GetDouble();
+        const int rating = reader.GetInt32();
+        documents.emplace_back(id, relevance, rating);
+    }
+    CheckComplete(reader);
+    return documents;
+}
+
+void ParseMatchResponse(const Frame& frame, std::vector<std::string>& words, DocumentStatus& status) {
+    PayloadReader reader = CheckResponse(frame);
+    const uint8_t raw_status = reader.GetUint8();
+    const uint32_t word_count = reader.GetUint32();
+    if (!IsValidStatus(raw_status) || word_count > frame.payload_size / 4) {
+        throw std::runtime_error("malformed response"s);
+    }
+    words.clear();
+    words.reserve(word_count);
+    for (uint32_t i = 0; i < word_count; ++i) {
+        words.emplace_back(reader.GetString());
+    }
+    CheckComplete(reader);
+    status = static_cast<DocumentStatus>(raw_status);
+}
+
+void ParseEmptyResponse(const Frame& frame) {
+    CheckComplete(CheckResponse(frame));
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Binary protocol of QueryService. Every request and response is a frame: a 32-bit payload size,
+// a one-byte request type or response code and the payload. Integers are little-endian, doubles
+// are sent as the bits of an IEEE 754 double and strings as a 32-bit size followed by the bytes.
+// A connection may send any number of requests without waiting, the responses come back in the
+// order of the requests.
+//
+// Request payloads:
+//   FIND_TOP_DOCUMENTS  status: uint8, query: string
+//   MATCH_DOCUMENT      document id: int32, query: string
+//   ADD_DOCUMENT        document id: int32, status: uint8, ratings: uint32 count + int32[], text: string
+//   REMOVE_DOCUMENT     document id: int32
+//
+// Response payloads for OK:
+//   FIND_TOP_DOCUMENTS  uint32 count + (id: int32, relevance: double, rating: int32)[]
+//   MATCH_DOCUMENT      status: uint8, words: uint32 count + string[]
+//   ADD_DOCUMENT        empty
+//   REMOVE_DOCUMENT     empty
+// Any other code carries an error message: string.
+
+const size_t FRAME_HEADER_SIZE = 5;
+
+// Larger frames are rejected and the connection is closed.
+const uint32_t MAX_FRAME_PAYLOAD_SIZE = 16 * 1024 * 1024;
+
+enum class RequestType : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    ADD_DOCUMENT = 3,
+    REMOVE_DOCUMENT = 4,
+};
+
+// The codes of the exceptions that SearchServer throws, so that a client can rethrow them.
+enum class ResponseCode : uint8_t {
+    OK = 0,
+    INVALID_ARGUMENT = 1,
+    OUT_OF_RANGE = 2,
+    BAD_REQUEST = 3,
+    INTERNAL_ERROR = 4,
+};
+
+struct Frame {
+    uint8_t type;
+    const uint8_t* payload;
+    uint32_t payload_size;
+};
+
+enum class FrameStatus {
+    COMPLETE,
+    INCOMPLETE,
+    TOO_LARGE,
+};
+
+// Finds the frame at the beginning of data, which takes FRAME_HEADER_SIZE + payload_size bytes.
+FrameStatus ReadFrame(const uint8_t* data, size_t size, Frame& frame);
+
+// A decoded request. The strings are views into the payload it was decoded from.
+struct Request {
+    RequestType type;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::string_view text;
+    std::vector<int> ratings;
+};
+
+// False if the frame is not a well-formed request.
+bool ParseRequest(const Frame& frame, Request& request);
+
+// Appends frames to a buffer, the payload size is filled in by EndFrame.
+class FrameWriter {
+public:
+    explicit FrameWriter(std::vector<uint8_t>& out)
+        : out_(out)
+    {}
+
+    void BeginFrame(uint8_t type);
+
+    void EndFrame();
+
+    void PutUint8(uint8_t value);
+
+    void PutUint32(uint32_t value);
+
+    void PutInt32(int32_t value);
+
+    void PutDouble(double value);
+
+    void PutString(std::string_view value);
+
+private:
+    std::vector<uint8_t>& out_;
+    size_t frame_begin_ = 0;
+};
+
+// Reads the fields of a payload in order. Reading past its end fails the reader instead of
+// throwing, the values read then are zero or empty.
+class PayloadReader {
+public:
+    explicit PayloadReader(const Frame& frame)
+        : position_(frame.payload), end_(frame.payload + frame.payload_size)
+    {}
+
+    uint8_t GetUint8();
+
+    uint32_t GetUint32();
+
+    int32_t GetInt32();
+
+    double GetDouble();
+
+    std::string_view GetString();
+
+    // True if every read so far was in bounds and the whole payload has been read.
+    bool IsComplete() const;
+
+private:
+    const uint8_t* position_;
+    const uint8_t* end_;
+    bool is_valid_ = true;
+
+    const uint8_t* Take(size_t size);
+};
+
+void WriteFindTopDocumentsRequest(std::vector<uint8_t>& out, std::string_view query, DocumentStatus status);
+
+void WriteMatchDocumentRequest(std::vector<uint8_t>& out, std::string_view query, int document_id);
+
+void WriteAddDocumentRequest(std::vector<uint8_t>& out, int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+void WriteRemoveDocumentRequest(std::vector<uint8_t>& out, int document_id);
+
+void WriteDocumentsResponse(std::vector<uint8_t>& out, const std::vector<Document>& documents);
+
+void WriteMatchResponse(std::vector<uint8_t>& out, const std::vector<std::string_view>& words, DocumentStatus status);
+
+void WriteEmptyResponse(std::vector<uint8_t>& out);
+
+void WriteErrorResponse(std::vector<uint8_t>& out, ResponseCode code, std::string_view message);
+
+// Throw the exception that an error response stands for, or runtime_error for a malformed one.
+std::vector<Document> ParseDocumentsResponse(const Frame& frame);
+
+void ParseMatchResponse(const Frame& frame, std::vector<std::string>& words, DocumentStatus& status);
+
+void ParseEmptyResponse(const Frame& frame);
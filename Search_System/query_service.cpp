@@ -0,0 +1,418 @@
+#include "query_service.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+#ifdef __linux__
+
+namespace {
+
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+// A pass reads at most this much from one connection, so that one busy client cannot hold up the others.
+const size_t MAX_READ_PER_PASS = 1024 * 1024;
+
+// A connection is not read from while this much of its output waits for the peer.
+const size_t MAX_PENDING_OUTPUT = 4 * 1024 * 1024;
+
+std::runtime_error SystemError(const std::string& what) {
+    return std::runtime_error(what + ": "s + std::strerror(errno));
+}
+
+void Watch(int epoll_fd, int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        throw SystemError("epoll_ctl"s);
+    }
+}
+
+int Listen(int socket_fd, const sockaddr* address, socklen_t address_size, const std::string& name) {
+    if (socket_fd < 0) {
+        throw SystemError("Cannot create a socket for "s + name);
+    }
+    if (bind(socket_fd, address, address_size) != 0 || listen(socket_fd, SOMAXCONN) != 0) {
+        const std::runtime_error error = SystemError("Cannot listen on "s + name);
+        close(socket_fd);
+        throw error;
+    }
+    return socket_fd;
+}
+
+} // namespace
+
+QueryService::QueryService(SearchServer& search_server, ThreadPool& pool, const QueryServiceOptions& options)
+    : search_server_(search_server), pool_(pool), options_(options)
+{
+    // The destructor does not run for a constructor that throws, so the sockets opened so far are closed here.
+    try {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            throw SystemError("epoll_create1"s);
+        }
+        stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (stop_fd_ < 0) {
+            throw SystemError("eventfd"s);
+        }
+        Watch(epoll_fd_, stop_fd_, EPOLLIN);
+
+        if (options_.listen_tcp) {
+            const std::string name = options_.tcp_address + ":"s + std::to_string(options_.tcp_port);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(options_.tcp_port);
+            if (inet_pton(AF_INET, options_.tcp_address.c_str(), &address.sin_addr) != 1) {
+                throw std::invalid_argument("Invalid IPv4 address "s + options_.tcp_address);
+            }
+            const int socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            const int reuse_address = 1;
+            if (socket_fd >= 0) {
+                setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+            }
+            tcp_fd_ = Listen(socket_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address), name);
+            socklen_t address_size = sizeof(address);
+            if (getsockname(tcp_fd_, reinterpret_cast<sockaddr*>(&address), &address_size) != 0) {
+                throw SystemError("getsockname"s);
+            }
+            tcp_port_ = ntohs(address.sin_port);
+            Watch(epoll_fd_, tcp_fd_, EPOLLIN);
+        }
+
+        if (!options_.unix_socket_path.empty()) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (options_.unix_socket_path.size() >= sizeof(address.sun_path)) {
+                throw std::invalid_argument("Unix socket path is too long: "s + options_.unix_socket_path);
+            }
+            std::memcpy(address.sun_path, options_.unix_socket_path.data(), options_.unix_socket_path.size());
+            unlink(options_.unix_socket_path.c_str());
+            unix_fd_ = Listen(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0),
+                reinterpret_cast<const sockaddr*>(&address), sizeof(address), options_.unix_socket_path);
+            Watch(epoll_fd_, unix_fd_, EPOLLIN);
+        }
+    } catch (...) {
+        CloseAll();
+        throw;
+    }
+}
+
+QueryService::~QueryService() {
+    CloseAll();
+}
+
+uint16_t QueryService::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void QueryService::Run() {
+    std::vector<epoll_event> events(256);
+    while (true) {
+        const int event_count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw SystemError("epoll_wait"s);
+        }
+
+        bool is_stopping = false;
+        for (int i = 0; i < event_count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                uint64_t value;
+                (void)read(stop_fd_, &value, sizeof(value));
+                is_stopping = true;
+                continue;
+            }
+            if (fd == tcp_fd_ || fd == unix_fd_) {
+                Accept(fd, fd == tcp_fd_);
+                continue;
+            }
+            // Connections are only closed at the end of a pass, so every event has its connection.
+            Connection& connection = *connections_.at(fd);
+            if (!connection.is_active) {
+                connection.is_active = true;
+                active_connections_.push_back(&connection);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                Read(connection);
+            }
+        }
+
+        ExecutePendingRequests();
+
+        for (Connection* connection : active_connections_) {
+            connection->input.erase(connection->input.begin(), connection->input.begin() + connection->parsed_size);
+            connection->parsed_size = 0;
+            connection->is_active = false;
+            Write(*connection);
+            if (connection->is_broken || (connection->is_read_closed && connection->sent_size == connection->output.size())) {
+                Close(*connection);
+            } else {
+                UpdateEvents(*connection);
+            }
+        }
+        active_connections_.clear();
+
+        if (is_stopping) {
+            return;
+        }
+    }
+}
+
+void QueryService::Stop() {
+    const uint64_t value = 1;
+    (void)write(stop_fd_, &value, sizeof(value));
+}
+
+void QueryService::CloseAll() {
+    for (const auto& [fd, connection] : connections_) {
+        close(fd);
+    }
+    connections_.clear();
+    for (const int fd : { tcp_fd_, unix_fd_, stop_fd_, epoll_fd_ }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (unix_fd_ >= 0) {
+        unlink(options_.unix_socket_path.c_str());
+    }
+    tcp_fd_ = unix_fd_ = stop_fd_ = epoll_fd_ = -1;
+}
+
+void QueryService::Accept(int listen_fd, bool is_tcp) {
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // EAGAIN once the backlog is empty. Other errors, such as running out of descriptors,
+            // leave the rest of the backlog for a later pass.
+            return;
+        }
+        if (is_tcp) {
+            // Responses are small and written once per pass, delaying them only adds latency.
+            const int no_delay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        Watch(epoll_fd_, fd, connection->events);
+        connections_.emplace(fd, std::move(connection));
+    }
+}
+
+void QueryService::Read(Connection& connection) {
+    if (connection.is_read_closed || connection.is_broken) {
+        return;
+    }
+    size_t read_size = 0;
+    while (read_size < MAX_READ_PER_PASS) {
+        const size_t old_size = connection.input.size();
+        connection.input.resize(old_size + READ_CHUNK_SIZE);
+        const ssize_t received = recv(connection.fd, connection.input.data() + old_size, READ_CHUNK_SIZE, 0);
+        connection.input.resize(old_size + std::max<ssize_t>(received, 0));
+        if (received > 0) {
+            read_size += static_cast<size_t>(received);
+        } else if (received == 0) {
+            connection.is_read_closed = true;
+            break;
+        } else if (errno != EINTR) {
+            connection.is_broken = errno != EAGAIN && errno != EWOULDBLOCK;
+            break;
+        }
+    }
+    ParseRequests(connection);
+}
+
+void QueryService::ParseRequests(Connection& connection) {
+    while (true) {
+        Frame frame;
+        const FrameStatus status = ReadFrame(connection.input.data() + connection.parsed_size, connection.input.size() - connection.parsed_size, frame);
+        if (status == FrameStatus::INCOMPLETE) {
+            return;
+        }
+        PendingRequest pending_request{ &connection, {}, false };
+        if (status == FrameStatus::TOO_LARGE) {
+            // The stream cannot be resynchronized after an oversized frame: it is answered with an
+            // error and nothing more is read.
+            pending_requests_.push_back(std::move(pending_request));
+            connection.parsed_size = connection.input.size();
+            connection.is_read_closed = true;
+            return;
+        }
+        pending_request.is_valid = ParseRequest(frame, pending_request.request);
+        pending_requests_.push_back(std::move(pending_request));
+        connection.parsed_size += FRAME_HEADER_SIZE + frame.payload_size;
+    }
+}
+
+void QueryService::ExecutePendingRequests() {
+    const size_t max_batch_size = std::max<size_t>(options_.max_batch_size, 1);
+    size_t batch_begin = 0;
+    for (size_t index = 0; index < pending_requests_.size(); ++index) {
+        const PendingRequest& pending_request = pending_requests_[index];
+        if (pending_request.is_valid && pending_request.request.type == RequestType::FIND_TOP_DOCUMENTS
+            && pending_request.request.status == DocumentStatus::ACTUAL) {
+            if (index + 1 - batch_begin == max_batch_size) {
+                ExecuteBatch(batch_begin, index + 1);
+                batch_begin = index + 1;
+            }
+            continue;
+        }
+        ExecuteBatch(batch_begin, index);
+        Execute(pending_requests_[index]);
+        batch_begin = index + 1;
+    }
+    ExecuteBatch(batch_begin, pending_requests_.size());
+    pending_requests_.clear();
+}
+
+void QueryService::ExecuteBatch(size_t first, size_t last) {
+    if (last - first < 2) {
+        for (size_t index = first; index < last; ++index) {
+            Execute(pending_requests_[index]);
+        }
+        return;
+    }
+
+    batch_queries_.resize(last - first);
+    for (size_t index = first; index < last; ++index) {
+        batch_queries_[index - first].assign(pending_requests_[index].request.text);
+    }
+    std::vector<std::vector<Document>> results;
+    try {
+        results = search_server_.FindTopDocumentsBatch(batch_queries_, pool_);
+    } catch (const std::exception&) {
+        // One invalid query fails the whole batch, so every query is run again on its own to
+        // answer it with its own result or error.
+        for (size_t index = first; index < last; ++index) {
+            Execute(pending_requests_[index]);
+        }
+        return;
+    }
+    for (size_t index = first; index < last; ++index) {
+        WriteDocumentsResponse(pending_requests_[index].connection->output, results[index - first]);
+    }
+}
+
+void QueryService::Execute(PendingRequest& pending_request) {
+    std::vector<uint8_t>& output = pending_request.connection->output;
+    if (!pending_request.is_valid) {
+        WriteErrorResponse(output, ResponseCode::BAD_REQUEST, "malformed request"s);
+        return;
+    }
+    const Request& request = pending_request.request;
+    try {
+        switch (request.type) {
+        case RequestType::FIND_TOP_DOCUMENTS:
+            WriteDocumentsResponse(output, search_server_.FindTopDocuments(request.text, request.status));
+            break;
+        case RequestType::MATCH_DOCUMENT: {
+            const auto [words, status] = search_server_.MatchDocument(request.text, request.document_id);
+            WriteMatchResponse(output, words, status);
+            break;
+        }
+        case RequestType::ADD_DOCUMENT:
+            search_server_.AddDocument(request.document_id, request.text, request.status, request.ratings);
+            WriteEmptyResponse(output);
+            break;
+        case RequestType::REMOVE_DOCUMENT:
+            search_server_.RemoveDocument(request.document_id);
+            WriteEmptyResponse(output);
+            break;
+        }
+    } catch (const std::invalid_argument& error) {
+        WriteErrorResponse(output, ResponseCode::INVALID_ARGUMENT, error.what());
+    } catch (const std::out_of_range& error) {
+        WriteErrorResponse(output, ResponseCode::OUT_OF_RANGE, error.what());
+    } catch (const std::exception& error) {
+        WriteErrorResponse(output, ResponseCode::INTERNAL_ERROR, error.what());
+    }
+}
+
+void QueryService::Write(Connection& connection) {
+    while (!connection.is_broken && connection.sent_size < connection.output.size()) {
+        const ssize_t sent = send(connection.fd, connection.output.data() + connection.sent_size,
+            connection.output.size() - connection.sent_size, MSG_NOSIGNAL);
+        if (sent >= 0) {
+            connection.sent_size += static_cast<size_t>(sent);
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else if (errno != EINTR) {
+            connection.is_broken = true;
+        }
+    }
+    connection.output.clear();
+    connection.sent_size = 0;
+}
+
+void QueryService::UpdateEvents(Connection& connection) {
+    const size_t pending_output = connection.output.size() - connection.sent_size;
+    uint32_t events = 0;
+    if (!connection.is_read_closed && pending_output < MAX_PENDING_OUTPUT) {
+        events |= EPOLLIN;
+    }
+    if (pending_output > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == connection.events) {
+        return;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = connection.fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event) == 0) {
+        connection.events = events;
+    }
+}
+
+void QueryService::Close(Connection& connection) {
+    const int fd = connection.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+
+#else
+
+QueryService::QueryService(SearchServer& search_server, ThreadPool& pool, const QueryServiceOptions& options)
+    : search_server_(search_server), pool_(pool), options_(options)
+{
+    throw std::runtime_error("QueryService needs epoll, which this platform does not provide"s);
+}
+
+QueryService::~QueryService() = default;
+
+uint16_t QueryService::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void QueryService::Run() {
+}
+
+void QueryService::Stop() {
+}
+
+#endif
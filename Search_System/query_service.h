@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "query_protocol.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+struct QueryServiceOptions {
+    bool listen_tcp = true;
+    std::string tcp_address = "127.0.0.1";
+    // 0 picks a free port, see QueryService::GetTcpPort.
+    uint16_t tcp_port = 0;
+    // No Unix socket is created if the path is empty, an existing file at the path is replaced.
+    std::string unix_socket_path;
+    // The most queries passed to SearchServer::FindTopDocumentsBatch at once.
+    size_t max_batch_size = 256;
+};
+
+// Serves a SearchServer over the protocol of query_protocol.h on TCP and Unix sockets. One thread
+// runs an epoll loop over non-blocking connections; every pass reads whatever all ready
+// connections have sent, which may be many pipelined requests per connection, and executes them
+// in the order they were read. Runs of ACTUAL FindTopDocuments requests, from any connections, are
+// evaluated together with FindTopDocumentsBatch on the pool, while an update waits for the queries
+// read before it and is seen by the ones read after it, as if every request ran on its own.
+//
+// Needs epoll, on other platforms the constructor throws runtime_error.
+class QueryService {
+public:
+    QueryService(SearchServer& search_server, ThreadPool& pool, const QueryServiceOptions& options);
+
+    QueryService(const QueryService&) = delete;
+
+    QueryService& operator=(const QueryService&) = delete;
+
+    // Closes every connection and removes the Unix socket.
+    ~QueryService();
+
+    // The port the TCP socket is bound to, 0 if it does not listen on TCP.
+    uint16_t GetTcpPort() const;
+
+    // Serves connections on the calling thread until Stop is called.
+    void Run();
+
+    // May be called from any thread, Run returns after finishing its current pass.
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        // Bytes before parsed_size have been parsed into pending requests, which point into them.
+        std::vector<uint8_t> input;
+        size_t parsed_size = 0;
+        std::vector<uint8_t> output;
+        size_t sent_size = 0;
+        uint32_t events = 0;
+        // The peer will send nothing more, the connection closes once the output is sent.
+        bool is_read_closed = false;
+        bool is_broken = false;
+        bool is_active = false;
+    };
+
+    struct PendingRequest {
+        Connection* connection;
+        Request request;
+        bool is_valid;
+    };
+
+    SearchServer& search_server_;
+    ThreadPool& pool_;
+    QueryServiceOptions options_;
+
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    int tcp_fd_ = -1;
+    int unix_fd_ = -1;
+    uint16_t tcp_port_ = 0;
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+
+    // Connections read from during the current pass.
+    std::vector<Connection*> active_connections_;
+
+    std::vector<PendingRequest> pending_requests_;
+
+    std::vector<std::string> batch_queries_;
+
+    void CloseAll();
+
+    void Accept(int listen_fd, bool is_tcp);
+
+    void Read(Connection& connection);
+
+    void ParseRequests(Connection& connection);
+
+    void ExecutePendingRequests();
+
+    // Executes pending_requests_[first, last), which are all batchable queries.
+    void ExecuteBatch(size_t first, size_t last);
+
+    void Execute(PendingRequest& pending_request);
+
+    void Write(Connection& connection);
+
+    void UpdateEvents(Connection& connection);
+
+    void Close(Connection& connection);
+};
@@ -0,0 +1,29 @@
+#include "query_words.h"
+
+#include <algorithm>
+
+void QueryWords::push_back(std::string_view word) {
+    if (size_ < INLINE_WORD_COUNT) {
+        inline_words_[size_++] = word;
+        return;
+    }
+    if (size_ == INLINE_WORD_COUNT) {
+        heap_words_.assign(inline_words_.begin(), inline_words_.end());
+    }
+    heap_words_.push_back(word);
+    ++size_;
+}
+
+void QueryWords::SortUnique() {
+    std::string_view* const words = IsInline() ? inline_words_.data() : heap_words_.data();
+    std::sort(words, words + size_);
+    const size_t unique_size = static_cast<size_t>(std::unique(words, words + size_) - words);
+    if (!IsInline() && unique_size <= INLINE_WORD_COUNT) {
+        std::copy(words, words + unique_size, inline_words_.begin());
+        heap_words_.clear();
+    }
+    else if (!IsInline()) {
+        heap_words_.resize(unique_size);
+    }
+    size_ = unique_size;
+}
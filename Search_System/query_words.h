@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "string_processing.h"
+
+// Words of a parsed query as views into the query text. Up to INLINE_WORD_COUNT words are stored
+// in the object itself, so parsing a typical short query does not allocate. Longer queries move
+// their words to the heap.
+class QueryWords {
+public:
+    static constexpr size_t INLINE_WORD_COUNT = 8;
+
+    void push_back(std::string_view word);
+
+    // Sorts the words and drops the repeated ones, which gives the order of a std::set of them.
+    void SortUnique();
+
+    const std::string_view* begin() const {
+        return data();
+    }
+
+    const std::string_view* end() const {
+        return data() + size_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    std::array<std::string_view, INLINE_WORD_COUNT> inline_words_;
+    std::vector<std::string_view> heap_words_;
+    size_t size_ = 0;
+
+    bool IsInline() const {
+        return size_ <= INLINE_WORD_COUNT;
+    }
+
+    const std::string_view* data() const {
+        return IsInline() ? inline_words_.data() : heap_words_.data();
+    }
+};
+
+// Distinct plus and minus words of a query in sorted order.
+struct ParsedQuery {
+    QueryWords plus_words;
+    QueryWords minus_words;
+};
+
+// The query syntax of SearchServer and SnapshotSearchServer: words are separated by spaces, a
+// leading minus makes a minus word and the words is_stop_word accepts are dropped. Throws
+// invalid_argument for control characters, a lone minus and a double minus. The words are views
+// into text.
+template <typename StopWordPredicate>
+ParsedQuery ParseQueryWords(const std::string_view text, StopWordPredicate is_stop_word) {
+    using namespace std::string_literals;
+    ParsedQuery query;
+    thread_local std::vector<std::string_view> words;
+    words.clear();
+    if (!SplitIntoValidWords(text, words)) {
+        throw std::invalid_argument("Invalid symbol in query"s);
+    }
+    for (std::string_view word : words) {
+        if (word == "-") {
+            throw std::invalid_argument("no word after minus"s);
+        }
+        bool is_minus = false;
+        if (word[0] == '-' && word.size() > 1) {
+            if (word[1] == '-') {
+                throw std::invalid_argument("double minus in the word"s);
+            }
+            is_minus = true;
+            word.remove_prefix(1);
+        }
+        if (is_stop_word(word)) {
+            continue;
+        }
+        if (is_minus) {
+            query.minus_words.push_back(word);
+        }
+        else {
+            query.plus_words.push_back(word);
+        }
+    }
+    query.plus_words.SortUnique();
+    query.minus_words.SortUnique();
+    return query;
+}
@@ -1,20 +1,157 @@
 #include "request_queue.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void LatencyHistogram::Add(uint64_t latency_ns) {
+    ++counts_[GetBucket(latency_ns)];
+    ++count_;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        counts_[bucket] += other.counts_[bucket];
+    }
+    count_ += other.count_;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return count_;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(percentile / 100 * count_)), 1, count_);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= rank) {
+            return GetBucketUpperBound(bucket);
+        }
+    }
+    return GetBucketUpperBound(counts_.size() - 1);
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    int exponent = 0;
+    while ((value >> exponent) >= 2 * SUB_BUCKET_COUNT) {
+        ++exponent;
+    }
+    // value >> exponent is in [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT).
+    return (exponent + 1) * SUB_BUCKET_COUNT + static_cast<size_t>((value >> exponent) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const int exponent = static_cast<int>(bucket / SUB_BUCKET_COUNT) - 1;
+    const uint64_t lower = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << exponent;
+    return lower + ((uint64_t{ 1 } << exponent) - 1);
+}
+
+double RequestStats::GetNoResultRate() const {
+    return request_count == 0 ? 0 : static_cast<double>(no_result_count) / request_count;
+}
+
+void RequestStats::Merge(const RequestStats& other) {
+    request_count += other.request_count;
+    no_result_count += other.no_result_count;
+    document_count += other.document_count;
+    queries_per_second += other.queries_per_second;
+    latencies.Merge(other.latencies);
+}
+
+RequestQueue::RequestQueue(const SearchServer& search_server)
+    : server(search_server), start_(std::chrono::steady_clock::now())
+{}
+
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status_) {
-    return AddFindRequest(raw_query, [status_](int document_id, DocumentStatus status, int rating) { return status == status_; });
+    const auto request_start = std::chrono::steady_clock::now();
+    std::vector<Document> documents = server.FindTopDocuments(raw_query, status_);
+    Record(request_start, documents.size());
+    return documents;
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    return AddFindRequest(raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return NoResultRequests;
+    return static_cast<int>(GetStats().no_result_count);
+}
+
+RequestStats RequestQueue::GetStats() const {
+    return GetStats(std::chrono::nanoseconds::max());
 }
 
-void  RequestQueue::Push(QueryResult& result) {
-    requests_.push_back(result);
-    if (result.empty_docs) {
-        NoResultRequests++;
+RequestStats RequestQueue::GetStats(std::chrono::nanoseconds period) const {
+    const uint64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+    const uint64_t period_ns = static_cast<uint64_t>(period.count());
+    const uint64_t end_ticket = next_ticket_.load(std::memory_order_acquire);
+    const uint64_t begin_ticket = end_ticket > REQUEST_WINDOW ? end_ticket - REQUEST_WINDOW : 0;
+
+    RequestStats stats;
+    uint64_t first_timestamp_ns = std::numeric_limits<uint64_t>::max();
+    uint64_t last_timestamp_ns = 0;
+    for (uint64_t ticket = begin_ticket; ticket < end_ticket; ++ticket) {
+        const Slot& slot = slots_[ticket % REQUEST_WINDOW];
+        // Seqlock read: the record is used only if the slot held this ticket before and after it.
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const uint64_t timestamp_ns = slot.timestamp_ns.load(std::memory_order_relaxed);
+        const uint64_t latency_ns = slot.latency_ns.load(std::memory_order_relaxed);
+        const uint32_t hit_count = slot.hit_count.load(std::memory_order_relaxed);
+        const bool is_empty = slot.is_empty.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != (ticket + 1) * 2 || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        if (now_ns - std::min(now_ns, timestamp_ns) > period_ns) {
+            continue;
+        }
+        ++stats.request_count;
+        stats.no_result_count += is_empty ? 1 : 0;
+        stats.document_count += hit_count;
+        stats.latencies.Add(latency_ns);
+        first_timestamp_ns = std::min(first_timestamp_ns, timestamp_ns);
+        last_timestamp_ns = std::max(last_timestamp_ns, timestamp_ns);
+    }
+
+    // Over a given period the rate is per that period, otherwise per the span of the window.
+    const uint64_t span_ns = period != std::chrono::nanoseconds::max() ? period_ns
+        : stats.request_count > 1 ? last_timestamp_ns - first_timestamp_ns : 0;
+    if (span_ns > 0) {
+        stats.queries_per_second = stats.request_count * 1e9 / span_ns;
     }
-}
\ No newline at end of file
+    return stats;
+}
+
+void RequestQueue::Record(std::chrono::steady_clock::time_point request_start, size_t hit_count) {
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[ticket % REQUEST_WINDOW];
+
+    // The slot is claimed only from a published record of an earlier ticket. A writer stalled
+    // between taking its ticket and claiming may find the record of a later ticket, and a writer
+    // may find the slot still being written by one stalled a window earlier: either way the
+    // record is dropped, so two writers never store into one slot at once.
+    const uint64_t claimed = (ticket + 1) * 2 + WRITING;
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    do {
+        if ((sequence & WRITING) != 0 || sequence > claimed) {
+            return;
+        }
+    } while (!slot.sequence.compare_exchange_weak(sequence, claimed, std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestamp_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count(), std::memory_order_relaxed);
+    slot.latency_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(now - request_start).count(), std::memory_order_relaxed);
+    slot.hit_count.store(static_cast<uint32_t>(hit_count), std::memory_order_relaxed);
+    slot.is_empty.store(hit_count == 0, std::memory_order_relaxed);
+    slot.sequence.store((ticket + 1) * 2, std::memory_order_release);
+}
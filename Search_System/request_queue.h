@@ -1,15 +1,65 @@
 ﻿#pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
 #include <vector>
-#include <deque>
 
 #include "document.h"
 #include "search_server.h"
 
+// Latency histogram with buckets that grow geometrically: every power of two is split into
+// 2^SUB_BUCKET_BITS linear buckets, so a percentile is reported with at most 1/8 relative error.
+// Histograms of different threads or queues are combined with Merge.
+class LatencyHistogram {
+public:
+    void Add(uint64_t latency_ns);
+
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t GetCount() const;
+
+    // The upper bound of the bucket that holds the given percentile, in nanoseconds.
+    uint64_t GetPercentile(double percentile) const;
+
+private:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+
+    std::array<uint64_t, 64 * SUB_BUCKET_COUNT> counts_{};
+    uint64_t count_ = 0;
+
+    static size_t GetBucket(uint64_t value);
+
+    static uint64_t GetBucketUpperBound(size_t bucket);
+};
+
+struct RequestStats {
+    uint64_t request_count = 0;
+    uint64_t no_result_count = 0;
+    uint64_t document_count = 0;
+    double queries_per_second = 0;
+    LatencyHistogram latencies;
+
+    double GetNoResultRate() const;
+
+    // Combines the stats of front-ends that serve requests side by side.
+    void Merge(const RequestStats& other);
+};
+
+// Request front-end that keeps compact records of the last REQUEST_WINDOW requests in a ring
+// buffer. Any number of threads may add requests and read the stats concurrently: a request takes
+// a ticket with one atomic increment, claims the slot of the ticket with a compare-and-swap of its
+// sequence number and publishes its record through it, so neither writers nor readers ever take a
+// lock. A writer that finds its slot claimed by another writer drops its record instead of waiting,
+// which only happens when a writer stalls while a whole window of other requests is recorded.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server) : server(search_server)
-    {}
+    static constexpr size_t REQUEST_WINDOW = 1440;
+
+    explicit RequestQueue(const SearchServer& search_server);
 
     // ñäåëàåì "îá¸ðòêè" äëÿ âñåõ ìåòîäîâ ïîèñêà, ÷òîáû ñîõðàíÿòü ðåçóëüòàòû äëÿ íàøåé ñòàòèñòèêè
 
@@ -21,34 +71,39 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
     int GetNoResultRequests() const;
+
+    // Stats of the requests in the window.
+    RequestStats GetStats() const;
+
+    // Stats of the requests in the window that finished during the last period.
+    RequestStats GetStats(std::chrono::nanoseconds period) const;
+
 private:
-    struct QueryResult {
-        std::vector<Document> found_result;
-        bool empty_docs = false;
+    // A slot is padded to a cache line, neighbouring requests are usually recorded by different threads.
+    struct alignas(64) Slot {
+        // (ticket + 1) * 2 once the record of the ticket is published, plus WRITING while it is
+        // being written, 0 before the first record.
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<uint64_t> timestamp_ns{ 0 };
+        std::atomic<uint64_t> latency_ns{ 0 };
+        std::atomic<uint32_t> hit_count{ 0 };
+        std::atomic<bool> is_empty{ false };
     };
 
-    std::deque<QueryResult> requests_;
-    const static int sec_in_day_ = 1440;
+    static constexpr uint64_t WRITING = 1;
+
     const SearchServer& server;
-    int NoResultRequests = 0;
+    const std::chrono::steady_clock::time_point start_;
+    std::atomic<uint64_t> next_ticket_{ 0 };
+    std::array<Slot, REQUEST_WINDOW> slots_;
 
-    void Push(QueryResult& result);
+    void Record(std::chrono::steady_clock::time_point request_start, size_t hit_count);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    QueryResult result;
-    result.found_result = server.FindTopDocuments(raw_query, document_predicate);
-    result.empty_docs = result.found_result.empty();
-    if (requests_.size() < sec_in_day_) {
-        Push(result);
-    }
-    else {
-        if (requests_.front().empty_docs) {
-            NoResultRequests--;
-        }
-        requests_.pop_front();
-        Push(result);
-    }
-    return result.found_result;
-}
\ No newline at end of file
+    const auto request_start = std::chrono::steady_clock::now();
+    std::vector<Document> documents = server.FindTopDocuments(raw_query, document_predicate);
+    Record(request_start, documents.size());
+    return documents;
+}
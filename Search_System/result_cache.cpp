@@ -0,0 +1,146 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+void FrequencySketch::Reset(size_t capacity) {
+    size_t counter_count = 64;
+    while (counter_count < capacity * 4) {
+        counter_count *= 2;
+    }
+    counters_.assign(counter_count, 0);
+    access_count_ = 0;
+    sample_size_ = std::max<size_t>(capacity, 1) * 10;
+}
+
+void FrequencySketch::Increment(uint64_t hash) {
+    for (int row = 0; row < 4; ++row) {
+        uint8_t& counter = counters_[GetIndex(hash, row)];
+        if (counter < UINT8_MAX) {
+            ++counter;
+        }
+    }
+    if (++access_count_ == sample_size_) {
+        for (uint8_t& counter : counters_) {
+            counter /= 2;
+        }
+        access_count_ /= 2;
+    }
+}
+
+uint32_t FrequencySketch::Estimate(uint64_t hash) const {
+    uint32_t estimate = UINT8_MAX;
+    for (int row = 0; row < 4; ++row) {
+        estimate = std::min<uint32_t>(estimate, counters_[GetIndex(hash, row)]);
+    }
+    return estimate;
+}
+
+size_t FrequencySketch::GetIndex(uint64_t hash, int row) const {
+    // Every row mixes the hash with its own odd multiplier and takes the high bits.
+    static constexpr uint64_t SEEDS[4] = { 0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL };
+    return static_cast<size_t>(((hash + row) * SEEDS[row]) >> 32) & (counters_.size() - 1);
+}
+
+ResultCache::ResultCache(size_t capacity)
+    : shards_(capacity > 0 ? SHARD_COUNT : 0)
+{
+    Reset(capacity);
+}
+
+ResultCache::ResultCache(const ResultCache& other)
+    : shards_(other.capacity_ > 0 ? SHARD_COUNT : 0)
+{
+    Reset(other.capacity_);
+}
+
+ResultCache& ResultCache::operator=(const ResultCache& other) {
+    if (this != &other) {
+        std::vector<Shard> shards(other.capacity_ > 0 ? SHARD_COUNT : 0);
+        shards_.swap(shards);
+        Reset(other.capacity_);
+    }
+    return *this;
+}
+
+bool ResultCache::Find(const std::string& key, uint64_t generation, std::vector<Document>& documents) {
+    if (capacity_ == 0) {
+        return false;
+    }
+    const uint64_t hash = std::hash<std::string_view>{}(key);
+    Shard& shard = shards_[hash % SHARD_COUNT];
+    std::lock_guard guard(shard.mutex);
+    shard.sketch.Increment(hash);
+
+    const auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        ++shard.stats.misses;
+        return false;
+    }
+    const auto entry = found->second;
+    if (entry->generation != generation) {
+        shard.index.erase(found);
+        shard.entries.erase(entry);
+        ++shard.stats.misses;
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    documents = entry->documents;
+    ++shard.stats.hits;
+    return true;
+}
+
+void ResultCache::Insert(const std::string& key, uint64_t generation, const std::vector<Document>& documents) {
+    if (capacity_ == 0) {
+        return;
+    }
+    const uint64_t hash = std::hash<std::string_view>{}(key);
+    Shard& shard = shards_[hash % SHARD_COUNT];
+    std::lock_guard guard(shard.mutex);
+
+    const auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        // Another thread has computed the same query meanwhile.
+        found->second->generation = generation;
+        found->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        return;
+    }
+
+    if (shard.entries.size() >= shard.capacity) {
+        const Entry& victim = shard.entries.back();
+        const bool is_stale = victim.generation != generation;
+        if (!is_stale && shard.sketch.Estimate(hash) <= shard.sketch.Estimate(std::hash<std::string_view>{}(victim.key))) {
+            return;
+        }
+        shard.index.erase(victim.key);
+        shard.entries.pop_back();
+        ++shard.stats.evictions;
+    }
+    shard.entries.push_front({ key, generation, documents });
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+size_t ResultCache::GetCapacity() const {
+    return capacity_;
+}
+
+ResultCacheStats ResultCache::GetStats() const {
+    ResultCacheStats stats;
+    for (const Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        stats.hits += shard.stats.hits;
+        stats.misses += shard.stats.misses;
+        stats.evictions += shard.stats.evictions;
+    }
+    return stats;
+}
+
+void ResultCache::Reset(size_t capacity) {
+    capacity_ = capacity;
+    const size_t shard_capacity = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+    for (Shard& shard : shards_) {
+        shard.capacity = shard_capacity;
+        shard.sketch.Reset(shard_capacity);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+struct ResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Approximate access counts of cache keys: a count-min sketch of four rows of 8-bit counters that
+// are halved every time the sketch has counted ten accesses per cached entry, so that old
+// popularity fades out.
+class FrequencySketch {
+public:
+    void Reset(size_t capacity);
+
+    void Increment(uint64_t hash);
+
+    uint32_t Estimate(uint64_t hash) const;
+
+private:
+    std::vector<uint8_t> counters_;
+    size_t access_count_ = 0;
+    size_t sample_size_ = 0;
+
+    size_t GetIndex(uint64_t hash, int row) const;
+};
+
+// Thread-safe cache of top documents keyed by a normalized query. Keys are split between shards
+// that each have their own lock, LRU list and frequency sketch. A new key is only admitted in
+// place of the least recently used one when it has been requested more often (TinyLFU), so a burst
+// of one-off queries does not flush the popular ones. Every entry remembers the index generation
+// it was computed for and is dropped when it is found to be older than the current one.
+//
+// A cache of capacity 0, the default, caches nothing and allocates no shards.
+//
+// Copying a cache gives an empty cache with the same capacity: the entries belong to the index
+// they were computed from.
+class ResultCache {
+public:
+    explicit ResultCache(size_t capacity = 0);
+
+    ResultCache(const ResultCache& other);
+
+    ResultCache& operator=(const ResultCache& other);
+
+    bool Find(const std::string& key, uint64_t generation, std::vector<Document>& documents);
+
+    void Insert(const std::string& key, uint64_t generation, const std::vector<Document>& documents);
+
+    size_t GetCapacity() const;
+
+    ResultCacheStats GetStats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    // Shards are padded to a cache line so that neighbouring mutexes do not false-share.
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        // The most recently used entry first.
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        FrequencySketch sketch;
+        size_t capacity = 0;
+        ResultCacheStats stats;
+    };
+
+    size_t capacity_;
+
+    std::vector<Shard> shards_;
+
+    void Reset(size_t capacity);
+};
@@ -0,0 +1,23 @@
+#include "score_accumulator.h"
+
+#include <algorithm>
+
+ScoreAccumulator& ScoreAccumulator::ForThisThread() {
+    thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+void ScoreAccumulator::Reset(size_t document_count) {
+    if (document_count > epochs_.size()) {
+        relevances_.resize(document_count);
+        epochs_.resize(document_count, 0);
+    }
+    touched_.clear();
+
+    // Every query uses two tags: epoch_ for scored slots and epoch_ + 1 for excluded ones.
+    epoch_ += 2;
+    if (epoch_ == 0) {
+        std::fill(epochs_.begin(), epochs_.end(), 0);
+        epoch_ = 2;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance accumulator indexed by document ordinal. Slots are tagged with the epoch of the
+// query that wrote them, so starting a new query is O(1) instead of clearing the whole array.
+class ScoreAccumulator {
+public:
+    static ScoreAccumulator& ForThisThread();
+
+    void Reset(size_t document_count);
+
+    void Exclude(uint32_t ordinal) {
+        epochs_[ordinal] = epoch_ + 1;
+    }
+
+    bool IsExcluded(uint32_t ordinal) const {
+        return epochs_[ordinal] == epoch_ + 1;
+    }
+
+    void Add(uint32_t ordinal, double relevance) {
+        uint32_t& epoch = epochs_[ordinal];
+        if (epoch == epoch_) {
+            relevances_[ordinal] += relevance;
+        }
+        else if (epoch != epoch_ + 1) {
+            epoch = epoch_;
+            relevances_[ordinal] = relevance;
+            touched_.push_back(ordinal);
+        }
+    }
+
+    double GetRelevance(uint32_t ordinal) const {
+        return relevances_[ordinal];
+    }
+
+    const std::vector<uint32_t>& GetTouched() const {
+        return touched_;
+    }
+
+private:
+    std::vector<double> relevances_;
+
+    std::vector<uint32_t> epochs_;
+
+    std::vector<uint32_t> touched_;
+
+    uint32_t epoch_ = 0;
+};
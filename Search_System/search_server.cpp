@@ -1,161 +1,587 @@
 #include "search_server.h"
 
+#include "index_snapshot.h"
+#include "thread_pool.h"
+
 using namespace std::string_literals;
 
 SearchServer::SearchServer(const std::string_view text) {
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Invalid symbol in "s + as_string(word) + " word"s);
-        };
-        stop_words_.insert(as_string(word));
+    std::vector<std::string_view> words;
+    if (!SplitIntoValidWords(text, words)) {
+        throw std::invalid_argument("Invalid symbol in stop words"s);
+    }
+    for (const std::string_view word : words) {
+        AddStopWord(word);
     }
 }
 
 SearchServer::SearchServer(const std::string text) : SearchServer(std::string_view(text)) {}
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if (document_id < 0) {
-        throw std::invalid_argument("Document id < 0"s);
+    const TokenizedDocument tokenized_document = TokenizeDocument(document);
+    ValidateNewDocument(document_id, document_ordinals_.count(document_id) > 0, tokenized_document.is_valid);
+    bool is_duplicate = false;
+    if (duplicate_mode_ != DuplicateMode::ALLOW) {
+        std::vector<uint32_t> sorted_term_ids;
+        is_duplicate = GetSortedTermIds(tokenized_document, sorted_term_ids)
+            && IsIndexedDuplicate(ComputeDocumentSignature(sorted_term_ids), sorted_term_ids);
+        if (is_duplicate && duplicate_mode_ == DuplicateMode::REJECT) {
+            throw std::invalid_argument("Document "s + std::to_string(document_id) + " duplicates an indexed document"s);
+        }
     }
-    if (documents_.count(document_id)) {
-        throw std::invalid_argument("Document with this document id, is in the list"s);
+
+    const uint32_t ordinal = static_cast<uint32_t>(document_ids_.size());
+    std::vector<TermCount> term_counts(tokenized_document.words.size());
+    for (size_t i = 0; i < tokenized_document.words.size(); ++i) {
+        term_counts[i] = { terms_.Insert(tokenized_document.words[i]), tokenized_document.counts[i] };
+    }
+    std::sort(term_counts.begin(), term_counts.end(), [](const TermCount& lhs, const TermCount& rhs) {
+        return lhs.term_id < rhs.term_id;
+        });
+    forward_index_.AddDocument(term_counts);
+    if (terms_.GetTermCount() > mutable_postings_.size()) {
+        mutable_postings_.resize(terms_.GetTermCount());
+        document_freqs_.resize(terms_.GetTermCount());
+        log_document_freqs_.resize(terms_.GetTermCount());
+    }
+    for (const auto [term_id, term_count] : term_counts) {
+        mutable_postings_[term_id].Insert(ordinal, term_count, RoundUpTermFreq(static_cast<double>(term_count) / tokenized_document.length));
+        ++document_freqs_[term_id];
+        UpdateLogDocumentFreq(term_id);
     }
-    if (!IsValidWord(document)) {
-        throw std::invalid_argument("Invalid symbol in " + document_id);
+
+    document_ordinals_.emplace(document_id, ordinal);
+    document_ids_.push_back(document_id);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    document_lengths_.push_back(tokenized_document.length);
+    document_removed_.push_back(0);
+
+    IDs.insert(document_id);
+    UpdateLogDocumentCount();
+    if (duplicate_mode_ != DuplicateMode::ALLOW) {
+        AddDocumentSignature(ordinal);
+        if (is_duplicate) {
+            flagged_duplicate_ordinals_.push_back(ordinal);
+        }
+    }
+
+    ++generation_;
+    MaintainSegments();
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+
+    // Tokenizing and counting only read the dictionary, so every document is processed on its own.
+    std::vector<TokenizedDocument> tokenized_documents(documents.size());
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        tokenized_documents[index] = TokenizeDocument(documents[index].text);
+        });
+
+    std::unordered_set<int> batch_ids;
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const int document_id = documents[index].id;
+        const bool is_duplicate = document_ordinals_.count(document_id) > 0 || !batch_ids.insert(document_id).second;
+        ValidateNewDocument(document_id, is_duplicate, tokenized_documents[index].is_valid);
+    }
+
+    const size_t partition_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    const size_t chunk_count = std::min(documents.size(), partition_count);
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    const auto for_each_document = [&](size_t chunk, auto callback) {
+        for (size_t index = documents.size() * chunk / chunk_count; index < documents.size() * (chunk + 1) / chunk_count; ++index) {
+            callback(index, tokenized_documents[index]);
+        }
     };
-    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
 
-    for (const std::string_view& word_view : words) {
-        std::string word = as_string(word_view);
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        id_word_to_freqs[document_id][word] += inv_word_count;
+    // Known terms are resolved in parallel and every chunk lists its new words in the order of
+    // their first occurrence. Inserting those lists chunk by chunk gives the term ids AddDocument
+    // would give, while the sequential part only sees each new word once per chunk.
+    std::vector<std::vector<std::string_view>> chunk_new_words(chunk_count);
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        std::unordered_set<std::string_view> new_words;
+        for_each_document(chunk, [&](size_t, TokenizedDocument& document) {
+            document.term_ids.reserve(document.words.size());
+            for (const std::string_view word : document.words) {
+                const uint32_t term_id = terms_.Find(word);
+                document.term_ids.push_back(term_id);
+                if (term_id == TermDictionary::NO_TERM && new_words.insert(word).second) {
+                    chunk_new_words[chunk].push_back(word);
+                }
+            }
+            });
+        });
+    for (const std::vector<std::string_view>& new_words : chunk_new_words) {
+        for (const std::string_view word : new_words) {
+            terms_.Insert(word);
+        }
+    }
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        for_each_document(chunk, [&](size_t, TokenizedDocument& document) {
+            for (size_t i = 0; i < document.words.size(); ++i) {
+                if (document.term_ids[i] == TermDictionary::NO_TERM) {
+                    document.term_ids[i] = terms_.Find(document.words[i]);
+                }
+            }
+            });
+        });
+
+    // Duplicates are checked once every word has a term id and before anything is indexed. A
+    // rejected batch only leaves its new words in the dictionary, where a term without documents
+    // is never found by queries.
+    std::vector<DocumentSignature> signatures;
+    std::vector<uint8_t> is_duplicate(documents.size());
+    if (duplicate_mode_ != DuplicateMode::ALLOW) {
+        std::vector<std::vector<uint32_t>> sorted_term_ids(documents.size());
+        signatures.resize(documents.size());
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+            sorted_term_ids[index] = tokenized_documents[index].term_ids;
+            std::sort(sorted_term_ids[index].begin(), sorted_term_ids[index].end());
+            signatures[index] = ComputeDocumentSignature(sorted_term_ids[index]);
+            });
+        std::unordered_map<DocumentSignature, std::vector<size_t>, DocumentSignatureHasher> batch_indexes;
+        for (size_t index = 0; index < documents.size(); ++index) {
+            std::vector<size_t>& same_signature = batch_indexes[signatures[index]];
+            is_duplicate[index] = IsIndexedDuplicate(signatures[index], sorted_term_ids[index])
+                || std::any_of(same_signature.begin(), same_signature.end(), [&](size_t other) {
+                    return sorted_term_ids[other] == sorted_term_ids[index];
+                    });
+            if (is_duplicate[index] && duplicate_mode_ == DuplicateMode::REJECT) {
+                throw std::invalid_argument("Document "s + std::to_string(documents[index].id) + " duplicates an indexed document"s);
+            }
+            if (!is_duplicate[index]) {
+                same_signature.push_back(index);
+            }
+        }
+    }
+    if (terms_.GetTermCount() > mutable_postings_.size()) {
+        mutable_postings_.resize(terms_.GetTermCount());
+        document_freqs_.resize(terms_.GetTermCount());
+        log_document_freqs_.resize(terms_.GetTermCount());
     }
 
-    documents_.emplace(document_id,
-        DocumentData{
-            ComputeAverageRating(ratings),
-            status
+    // Every chunk of documents splits its postings by term partition, then every partition appends
+    // the postings of its own terms chunk by chunk, so posting lists stay sorted by ordinal and no
+    // posting list is touched by two threads.
+    const uint32_t first_ordinal = static_cast<uint32_t>(document_ids_.size());
+    std::vector<std::vector<std::vector<TermPosting>>> chunk_postings(chunk_count, std::vector<std::vector<TermPosting>>(partition_count));
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        for_each_document(chunk, [&](size_t index, const TokenizedDocument& document) {
+            const uint32_t ordinal = first_ordinal + static_cast<uint32_t>(index);
+            for (size_t i = 0; i < document.words.size(); ++i) {
+                const uint32_t term_id = document.term_ids[i];
+                chunk_postings[chunk][term_id % partition_count].push_back({ term_id, ordinal, document.counts[i],
+                    RoundUpTermFreq(static_cast<double>(document.counts[i]) / document.length) });
+            }
+            });
+        });
+    std::vector<size_t> partitions(partition_count);
+    std::iota(partitions.begin(), partitions.end(), 0);
+    // Bytes rather than std::vector<bool>, partitions mark their own terms concurrently.
+    std::vector<uint8_t> is_term_touched(terms_.GetTermCount());
+    std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](size_t partition) {
+        std::vector<uint32_t> touched_terms;
+        for (const std::vector<std::vector<TermPosting>>& postings : chunk_postings) {
+            for (const auto [term_id, ordinal, term_count, term_freq] : postings[partition]) {
+                mutable_postings_[term_id].Insert(ordinal, term_count, term_freq);
+                ++document_freqs_[term_id];
+                if (!is_term_touched[term_id]) {
+                    is_term_touched[term_id] = 1;
+                    touched_terms.push_back(term_id);
+                }
+            }
+        }
+        for (const uint32_t term_id : touched_terms) {
+            UpdateLogDocumentFreq(term_id);
+        }
         });
 
-    IDs.insert(document_id);
+    std::vector<std::vector<TermCount>> document_term_counts(documents.size());
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        const TokenizedDocument& document = tokenized_documents[index];
+        std::vector<TermCount>& term_counts = document_term_counts[index];
+        term_counts.resize(document.words.size());
+        for (size_t i = 0; i < document.words.size(); ++i) {
+            term_counts[i] = { document.term_ids[i], document.counts[i] };
+        }
+        std::sort(term_counts.begin(), term_counts.end(), [](const TermCount& lhs, const TermCount& rhs) {
+            return lhs.term_id < rhs.term_id;
+            });
+        });
+    forward_index_.AddDocuments(document_term_counts);
+
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const NewDocument& document = documents[index];
+        document_ordinals_.emplace_hint(document_ordinals_.end(), document.id, first_ordinal + static_cast<uint32_t>(index));
+        document_ids_.push_back(document.id);
+        document_ratings_.push_back(ComputeAverageRating(document.ratings));
+        document_statuses_.push_back(document.status);
+        document_lengths_.push_back(tokenized_documents[index].length);
+        document_removed_.push_back(0);
+        IDs.insert(document.id);
+    }
+    UpdateLogDocumentCount();
+    if (duplicate_mode_ != DuplicateMode::ALLOW) {
+        for (size_t index = 0; index < documents.size(); ++index) {
+            const uint32_t ordinal = first_ordinal + static_cast<uint32_t>(index);
+            signature_ordinals_[signatures[index]].push_back(ordinal);
+            if (is_duplicate[index]) {
+                flagged_duplicate_ordinals_.push_back(ordinal);
+            }
+        }
+    }
 
+    ++generation_;
+    MaintainSegments();
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return static_cast<int>(document_ordinals_.size());
+}
+
+void SearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+    ++generation_;
+}
+
+size_t SearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+void SearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+    ++generation_;
+}
+
+RetrievalMode SearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_ = ResultCache(capacity);
+}
+
+ResultCacheStats SearchServer::GetResultCacheStats() const {
+    return result_cache_.GetStats();
+}
+
+size_t SearchServer::CountQueryWords(const std::string_view raw_query) const {
+    const Query query = ParseQuery(raw_query);
+    return query.plus_words.size() + query.minus_words.size();
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
-    return FindTopDocuments(raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+    return FindCachedTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status_) const {
-    return FindTopDocuments(raw_query, [status_](int document_id, DocumentStatus status, int rating) { return status == status_; });
+    return FindCachedTopDocuments(std::execution::seq, raw_query, status_);
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
 
-    if (IDs.count(document_id) == 0) {
-        throw std::out_of_range("Not found document id");
-    }
+    const uint32_t ordinal = GetDocumentOrdinal(document_id);
 
     if (!IsValidWord(raw_query)) {
-        throw std::invalid_argument("Invalid symbol in " + document_id);
+        throw std::invalid_argument("Invalid symbol in query for document "s + std::to_string(document_id));
     };
 
-    const Query query = ParseQuery(raw_query);
+    MatchQuery match_query;
+    ResolveMatchQuery(ParseQuery(raw_query), match_query);
 
     std::vector<std::string_view> matched_words;
+    MatchResolvedQuery(match_query, ordinal, matched_words);
 
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.at(as_string(word)).count(document_id)) {
-            return { matched_words, documents_.at(document_id).status };
-        }
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
-        }
+    return { matched_words, document_statuses_[ordinal] };
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy par, const std::string_view& raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy seq, const std::string_view& raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    MatchedDocuments matches;
+    MatchDocuments(raw_query, document_ids, matches);
+    return matches;
+}
+
+void SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids, MatchedDocuments& matches) const {
+    thread_local std::vector<uint32_t> ordinals;
+    ordinals.clear();
+    for (const int document_id : document_ids) {
+        ordinals.push_back(GetDocumentOrdinal(document_id));
     }
 
-    for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
-        }
-        char* arr = new char[word.size() + 1];
+    if (!IsValidWord(raw_query)) {
+        throw std::invalid_argument("Invalid symbol in query"s);
+    }
 
-        for (size_t i = 0; i < word.size(); i++) {
-            arr[i] = word.at(i);
-        }
+    thread_local MatchQuery match_query;
+    ResolveMatchQuery(ParseQuery(raw_query), match_query);
 
-        std::string_view push_view(arr, word.size());
+    matches.words.clear();
+    matches.word_offsets.assign(1, 0);
+    matches.statuses.clear();
+    for (const uint32_t ordinal : ordinals) {
+        MatchResolvedQuery(match_query, ordinal, matches.words);
+        matches.word_offsets.push_back(matches.words.size());
+        matches.statuses.push_back(document_statuses_[ordinal]);
+    }
+}
 
-        if (word_to_document_freqs_.at(as_string(word)).count(document_id)) {
-            matched_words.push_back(push_view);
-        }
+void SearchServer::AddStopWord(const std::string_view word) {
+    const uint32_t term_id = terms_.Insert(word);
+    if (term_id >= stop_words_.size()) {
+        stop_words_.resize(term_id + 1);
     }
+    stop_words_[term_id] = true;
+}
 
-    return { matched_words, documents_.at(document_id).status };
+bool SearchServer::IsStopWord(const std::string_view& word) const {
+    const uint32_t term_id = terms_.Find(word);
+    return term_id < stop_words_.size() && stop_words_[term_id];
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy par, const std::string_view& raw_query, int document_id) const {
+uint32_t SearchServer::FindIndexedTerm(const std::string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    if (term_id >= document_freqs_.size() || document_freqs_[term_id] == 0) {
+        return TermDictionary::NO_TERM;
+    }
+    return term_id;
+}
 
-    if (IDs.count(document_id) == 0) {
+uint32_t SearchServer::GetDocumentOrdinal(int document_id) const {
+    const auto found = document_ordinals_.find(document_id);
+    if (found == document_ordinals_.end()) {
         throw std::out_of_range("Not found document id");
     }
+    return found->second;
+}
 
-    if (!IsValidWord(raw_query)) {
-        throw std::invalid_argument("Invalid symbol in " + document_id);
+void SearchServer::MarkRemoved(uint32_t ordinal) {
+    document_removed_[ordinal] = 1;
+    forward_index_.RemoveDocument(ordinal);
+    // Compacting once half of the entries are garbage keeps removal amortized constant per term.
+    if (forward_index_.GetRemovedEntryCount() * 2 > forward_index_.GetEntryCount()) {
+        forward_index_.Compact(document_removed_);
+    }
+    ++generation_;
+    if (ordinal < mutable_begin_ordinal_) {
+        const auto segment = std::upper_bound(segments_.begin(), segments_.end(), ordinal, [](uint32_t ordinal, const SegmentEntry& entry) {
+            return ordinal < entry.segment->GetBeginOrdinal();
+            }) - 1;
+        ++segment->removed_document_count;
+    }
+    MaintainSegments();
+}
+
+std::vector<PostingListView> SearchServer::GetSegmentPostings(uint32_t term_id) const {
+    std::vector<PostingListView> postings;
+    for (const SegmentEntry& entry : segments_) {
+        const PostingListView segment_postings = entry.segment->GetPostings(term_id);
+        if (!segment_postings.empty()) {
+            postings.push_back(segment_postings);
+        }
     }
+    if (term_id < mutable_postings_.size() && !mutable_postings_[term_id].empty()) {
+        postings.push_back(mutable_postings_[term_id].GetView());
+    }
+    return postings;
+}
 
-    const Query query = ParseQuery(par, raw_query);
+PostingListView SearchServer::GetSegmentPostings(uint32_t term_id, uint32_t ordinal) const {
+    if (ordinal >= mutable_begin_ordinal_) {
+        return term_id < mutable_postings_.size() ? mutable_postings_[term_id].GetView() : PostingListView();
+    }
+    const auto segment = std::upper_bound(segments_.begin(), segments_.end(), ordinal, [](uint32_t ordinal, const SegmentEntry& entry) {
+        return ordinal < entry.segment->GetBeginOrdinal();
+        }) - 1;
+    return segment->segment->GetPostings(term_id);
+}
 
-    std::vector<std::string_view> matched_words;
+void SearchServer::MaintainSegments() {
+    InstallMergedSegment(false);
+    if (document_ids_.size() - mutable_begin_ordinal_ >= MUTABLE_SEGMENT_DOCUMENT_COUNT) {
+        SealMutableSegment();
+    }
+    if (pending_merge_ == nullptr) {
+        ScheduleMerge();
+    }
+}
 
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.at(as_string(word)).count(document_id)) {
-            return { matched_words, documents_.at(document_id).status };
-        }
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
-        }
+void SearchServer::SealMutableSegment() {
+    const uint32_t end_ordinal = static_cast<uint32_t>(document_ids_.size());
+    if (end_ordinal == mutable_begin_ordinal_) {
+        return;
     }
+    const uint32_t removed_document_count = static_cast<uint32_t>(std::count(
+        document_removed_.begin() + mutable_begin_ordinal_, document_removed_.end(), uint8_t{ 1 }));
+    segments_.push_back({
+        std::make_shared<const IndexSegment>(IndexSegment::Build(mutable_postings_, mutable_begin_ordinal_, end_ordinal)),
+        removed_document_count
+        });
+    mutable_postings_.clear();
+    mutable_begin_ordinal_ = end_ordinal;
+}
 
-    for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
+void SearchServer::ScheduleMerge() {
+    // Size tiers grow by SEGMENT_MERGE_FACTOR from the size of a sealed mutable segment. Merging
+    // the newest segments once SEGMENT_MERGE_FACTOR of them share a tier keeps the segment count
+    // logarithmic in the number of documents; a segment where at least half of the documents were
+    // removed is rewritten on its own to purge their postings.
+    const auto get_tier = [](const SegmentEntry& entry) {
+        size_t tier = 0;
+        for (uint64_t size = MUTABLE_SEGMENT_DOCUMENT_COUNT * SEGMENT_MERGE_FACTOR;
+            size <= entry.segment->GetEndOrdinal() - entry.segment->GetBeginOrdinal(); size *= SEGMENT_MERGE_FACTOR) {
+            ++tier;
         }
-        char* arr = new char[word.size() + 1];
+        return tier;
+    };
 
-        for (size_t i = 0; i < word.size(); i++) {
-            arr[i] = word.at(i);
+    size_t first_segment = segments_.size();
+    if (segments_.size() >= SEGMENT_MERGE_FACTOR) {
+        const size_t tier = get_tier(segments_.back());
+        first_segment = segments_.size() - SEGMENT_MERGE_FACTOR;
+        for (size_t i = first_segment; i < segments_.size(); ++i) {
+            if (get_tier(segments_[i]) != tier) {
+                first_segment = segments_.size();
+                break;
+            }
         }
-
-        std::string_view push_view(arr, word.size());
-
-        if (word_to_document_freqs_.at(as_string(word)).count(document_id)) {
-            matched_words.push_back(push_view);
+    }
+    size_t segment_count = segments_.size() - first_segment;
+    if (segment_count == 0) {
+        for (size_t i = 0; i < segments_.size(); ++i) {
+            const IndexSegment& segment = *segments_[i].segment;
+            if (segments_[i].removed_document_count * 2 >= segment.GetEndOrdinal() - segment.GetBeginOrdinal()) {
+                first_segment = i;
+                segment_count = 1;
+                break;
+            }
         }
     }
+    if (segment_count == 0) {
+        return;
+    }
 
-    return { matched_words, documents_.at(document_id).status };
+    auto merge = std::make_shared<PendingMerge>();
+    merge->first_segment = first_segment;
+    merge->removed_document_count = 0;
+    for (size_t i = first_segment; i < first_segment + segment_count; ++i) {
+        merge->segments.push_back(segments_[i].segment);
+        merge->removed_document_count += segments_[i].removed_document_count;
+    }
+    const uint32_t begin_ordinal = merge->segments.front()->GetBeginOrdinal();
+    const uint32_t end_ordinal = merge->segments.back()->GetEndOrdinal();
+    // The merge sees the removals made so far, later ones stay in removed_document_count of the
+    // merged segment.
+    std::vector<uint8_t> removed(document_removed_.begin() + begin_ordinal, document_removed_.begin() + end_ordinal);
+    std::vector<uint32_t> lengths(document_lengths_.begin() + begin_ordinal, document_lengths_.begin() + end_ordinal);
+    merge->result = std::async(std::launch::async, [segments = merge->segments, removed = std::move(removed), lengths = std::move(lengths)]() {
+        std::vector<const IndexSegment*> sources;
+        for (const std::shared_ptr<const IndexSegment>& segment : segments) {
+            sources.push_back(segment.get());
+        }
+        return std::make_shared<const IndexSegment>(IndexSegment::Merge(sources, removed, lengths));
+        }).share();
+    pending_merge_ = std::move(merge);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy seq, const std::string_view& raw_query, int document_id) const {
-    return MatchDocument(raw_query, document_id);
+void SearchServer::InstallMergedSegment(bool wait) {
+    if (pending_merge_ == nullptr) {
+        return;
+    }
+    if (!wait && pending_merge_->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    const PendingMerge& merge = *pending_merge_;
+    const std::shared_ptr<const IndexSegment> merged = merge.result.get();
+
+    // Copies of the server share the pending merge, each installs it into its own segment list.
+    const size_t end_segment = merge.first_segment + merge.segments.size();
+    bool is_current = end_segment <= segments_.size();
+    uint32_t removed_document_count = 0;
+    for (size_t i = merge.first_segment; is_current && i < end_segment; ++i) {
+        is_current = segments_[i].segment == merge.segments[i - merge.first_segment];
+        removed_document_count += segments_[i].removed_document_count;
+    }
+    if (is_current) {
+        segments_[merge.first_segment] = { merged, removed_document_count - merge.removed_document_count };
+        segments_.erase(segments_.begin() + merge.first_segment + 1, segments_.begin() + end_segment);
+    }
+    pending_merge_.reset();
 }
 
-bool SearchServer::IsStopWord(const std::string_view& word) const {
-    return stop_words_.count(word) > 0;
+void SearchServer::ValidateNewDocument(int document_id, bool is_duplicate, bool is_valid_text) {
+    if (document_id < 0) {
+        throw std::invalid_argument("Document id < 0"s);
+    }
+    if (is_duplicate) {
+        throw std::invalid_argument("Document with this document id, is in the list"s);
+    }
+    if (!is_valid_text) {
+        throw std::invalid_argument("Invalid symbol in document "s + std::to_string(document_id));
+    }
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
-    std::vector<std::string_view> words;
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+SearchServer::TokenizedDocument SearchServer::TokenizeDocument(const std::string_view text) const {
+    TokenizedDocument document;
+    thread_local std::vector<std::string_view> words;
+    words.clear();
+    if (!SplitIntoValidWords(text, words)) {
+        document.is_valid = false;
+        return document;
+    }
+
+    // Distinct words are found with an open-addressing table of positions in document.words that
+    // the thread reuses between documents, so stop words are looked up once per distinct word.
+    constexpr uint32_t NO_POSITION = UINT32_MAX;
+    thread_local std::vector<uint32_t> positions;
+    size_t slot_count = 16;
+    while (slot_count < words.size() * 2) {
+        slot_count *= 2;
+    }
+    if (positions.size() < slot_count) {
+        positions.assign(slot_count, NO_POSITION);
+    }
+    const size_t mask = slot_count - 1;
+    std::vector<size_t> used_slots;
+    for (const std::string_view word : words) {
+        size_t slot = TermDictionary::Hash(word) & mask;
+        while (positions[slot] != NO_POSITION && document.words[positions[slot]] != word) {
+            slot = (slot + 1) & mask;
+        }
+        if (positions[slot] == NO_POSITION) {
+            positions[slot] = static_cast<uint32_t>(document.words.size());
+            used_slots.push_back(slot);
+            document.words.push_back(word);
+            document.counts.push_back(0);
+        }
+        ++document.counts[positions[slot]];
+    }
+    for (const size_t slot : used_slots) {
+        positions[slot] = NO_POSITION;
+    }
+
+    size_t kept_count = 0;
+    for (size_t i = 0; i < document.words.size(); ++i) {
+        if (!IsStopWord(document.words[i])) {
+            document.length += document.counts[i];
+            document.words[kept_count] = document.words[i];
+            document.counts[kept_count] = document.counts[i];
+            ++kept_count;
         }
     }
-    return words;
+    document.words.resize(kept_count);
+    document.counts.resize(kept_count);
+    return document;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -166,77 +592,232 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-    bool is_minus = false;
+SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
+    return ParseQueryWords(text, [this](const std::string_view word) {
+        return IsStopWord(word);
+        });
+}
 
-    if (!IsValidWord(text)) {
-        throw std::invalid_argument(" Invalid symbol in "s + as_string(text) + " word"s);
-    };
+void SearchServer::ResolveMatchQuery(const Query& query, MatchQuery& match_query) const {
+    match_query.plus_term_ids.clear();
+    match_query.minus_term_ids.clear();
+    for (const std::string_view word : query.plus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            match_query.plus_term_ids.push_back(term_id);
+        }
+    }
+    for (const std::string_view word : query.minus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            match_query.minus_term_ids.push_back(term_id);
+        }
+    }
+    std::sort(match_query.plus_term_ids.begin(), match_query.plus_term_ids.end());
+    std::sort(match_query.minus_term_ids.begin(), match_query.minus_term_ids.end());
+}
+
+void SearchServer::MatchResolvedQuery(const MatchQuery& match_query, uint32_t ordinal, std::vector<std::string_view>& matched_words) const {
+    const size_t first_word = matched_words.size();
+    IntersectDocumentTerms(ordinal, match_query.minus_term_ids, matched_words);
+    if (matched_words.size() != first_word) {
+        matched_words.resize(first_word);
+        return;
+    }
+    IntersectDocumentTerms(ordinal, match_query.plus_term_ids, matched_words);
+    // Found in the order of term ids, the words of a query are reported in the order of the text.
+    std::sort(matched_words.begin() + first_word, matched_words.end());
+}
 
-    if (text.empty()) {
-        return {
-            text,
-            is_minus,
-            IsStopWord(text)
-        };
+void SearchServer::IntersectDocumentTerms(uint32_t ordinal, const std::vector<uint32_t>& sorted_term_ids, std::vector<std::string_view>& matched_words) const {
+    // Both lists are sorted, so every search starts where the previous one stopped.
+    const ForwardIndex::TermRange document_terms = forward_index_.GetTerms(ordinal);
+    auto it = document_terms.begin();
+    for (const uint32_t term_id : sorted_term_ids) {
+        it = std::lower_bound(it, document_terms.end(), term_id, [](const TermCount& term_count, uint32_t term_id) {
+            return term_count.term_id < term_id;
+            });
+        if (it == document_terms.end()) {
+            break;
+        }
+        if (it->term_id == term_id) {
+            matched_words.push_back(terms_.GetTerm(term_id));
+        }
     }
+}
 
-    if (text == "-") {
-        throw std::invalid_argument("no word after minus"s);
+double SearchServer::ComputeWordInverseDocumentFreq(uint32_t term_id) const {
+    return log_document_count_ - log_document_freqs_[term_id];
+}
+
+void SearchServer::UpdateLogDocumentFreq(uint32_t term_id) {
+    log_document_freqs_[term_id] = document_freqs_[term_id] > 0 ? log(document_freqs_[term_id]) : 0.0;
+}
+
+void SearchServer::UpdateLogDocumentCount() {
+    log_document_count_ = GetDocumentCount() > 0 ? log(GetDocumentCount()) : 0.0;
+}
+
+std::string SearchServer::GetResultCacheKey(const Query& query, DocumentStatus status) {
+    // Valid words never contain control characters, so they can separate the parts of the key.
+    std::string key(1, static_cast<char>('0' + static_cast<int>(status)));
+    for (const std::string_view word : query.plus_words) {
+        key += '\x01';
+        key += word;
+    }
+    for (const std::string_view word : query.minus_words) {
+        key += '\x02';
+        key += word;
+    }
+    return key;
+}
+
+SearchServer::ResolvedTerm SearchServer::ResolveTerm(const std::string_view word) const {
+    ResolvedTerm term;
+    const uint32_t term_id = FindIndexedTerm(word);
+    if (term_id != TermDictionary::NO_TERM) {
+        term.postings = GetSegmentPostings(term_id);
+        term.inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
     }
+    return term;
+}
 
-    if (text[0] == '-' && text.size() > 1) {
-        if (text[1] == '-') {
-            throw std::invalid_argument("double minus in the word"s);
+void SearchServer::AppendQueryTerm(const ResolvedTerm& term, bool is_minus, QueryTerms& terms) {
+    // Every document has its postings in one segment, so the segments of a term add up to the
+    // same relevance in the same term order as a single posting list would.
+    for (const PostingListView& postings : term.postings) {
+        if (is_minus) {
+            terms.minus_terms.push_back(postings);
+        }
+        else {
+            terms.plus_terms.push_back({ postings, term.inverse_document_freq });
         }
-        is_minus = true;
-        text = text.substr(1);
     }
+}
 
-    return {
-        text,
-        is_minus,
-        IsStopWord(text)
-    };
+QueryTerms SearchServer::ResolveQueryTerms(const Query& query) const {
+    QueryTerms terms;
+    for (const std::string_view word : query.plus_words) {
+        AppendQueryTerm(ResolveTerm(word), false, terms);
+    }
+    for (const std::string_view word : query.minus_words) {
+        AppendQueryTerm(ResolveTerm(word), true, terms);
+    }
+    return terms;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
-    Query query;
-    for (const std::string_view word : SplitIntoWords(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.insert(as_string(query_word.data));
-            }
-            else {
-                query.plus_words.insert(as_string(query_word.data));
-            }
+QueryTerms SearchServer::ResolveQueryTerms(const Query& query, const CollectionStatistics& statistics) const {
+    // The IDF is split into logs exactly as in ComputeWordInverseDocumentFreq, so equal statistics
+    // give bit-identical relevance.
+    const double log_document_count = statistics.document_count > 0 ? log(statistics.document_count) : 0.0;
+    QueryTerms terms;
+    size_t word_index = 0;
+    for (const std::string_view word : query.plus_words) {
+        const int document_freq = word_index < statistics.word_document_freqs.size() ? statistics.word_document_freqs[word_index] : 0;
+        ++word_index;
+        // The statistics may predate documents added to this server since, a word no document had
+        // then is left out instead of getting an infinite IDF.
+        if (document_freq <= 0) {
+            continue;
         }
+        ResolvedTerm term = ResolveTerm(word);
+        term.inverse_document_freq = log_document_count - log(document_freq);
+        AppendQueryTerm(term, false, terms);
+    }
+    for (const std::string_view word : query.minus_words) {
+        AppendQueryTerm(ResolveTerm(word), true, terms);
+    }
+    return terms;
+}
+
+CollectionStatistics SearchServer::GetQueryStatistics(const std::string_view raw_query) const {
+    const Query query = ParseQuery(raw_query);
+    CollectionStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    statistics.word_document_freqs.reserve(query.plus_words.size());
+    for (const std::string_view word : query.plus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        statistics.word_document_freqs.push_back(term_id == TermDictionary::NO_TERM ? 0 : static_cast<int>(document_freqs_[term_id]));
     }
+    return statistics;
+}
 
-    return query;
+void CollectionStatistics::Merge(const CollectionStatistics& other) {
+    document_count += other.document_count;
+    word_document_freqs.resize(std::max(word_document_freqs.size(), other.word_document_freqs.size()));
+    for (size_t i = 0; i < other.word_document_freqs.size(); ++i) {
+        word_document_freqs[i] += other.word_document_freqs[i];
+    }
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, ThreadPool& pool) const {
+    return FindTopDocumentsBatch(raw_queries.begin(), raw_queries.end(), pool);
 }
 
-bool SearchServer::IsValidWord(const std::string& word) const {
-    for (const char c : word) {
-        if (c >= '\0' && c < ' ') {
-            return false;
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::vector<std::string>::const_iterator first, std::vector<std::string>::const_iterator last, ThreadPool& pool) const {
+    const size_t query_count = static_cast<size_t>(last - first);
+    std::vector<Query> queries(query_count);
+    std::vector<std::string> keys(query_count);
+    pool.ParallelFor(query_count, [&](size_t index) {
+        queries[index] = ParseQuery(first[index]);
+        keys[index] = GetResultCacheKey(queries[index], DocumentStatus::ACTUAL);
+        });
+
+    // Queries that normalize to the same key are evaluated once.
+    std::unordered_map<std::string_view, size_t> distinct_indexes;
+    std::vector<size_t> distinct_queries;
+    std::vector<size_t> query_distinct_indexes(query_count);
+    for (size_t index = 0; index < query_count; ++index) {
+        const auto [position, is_new] = distinct_indexes.emplace(keys[index], distinct_queries.size());
+        if (is_new) {
+            distinct_queries.push_back(index);
         }
+        query_distinct_indexes[index] = position->second;
     }
-    return true;
-}
 
-bool SearchServer::IsValidWord(const std::string_view word) const {
-    for (const char c : word) {
-        if (c >= '\0' && c < ' ') {
-            return false;
+    // So is every term shared by several queries: its postings and IDF are looked up once.
+    std::unordered_map<std::string_view, ResolvedTerm> resolved_terms;
+    for (const size_t index : distinct_queries) {
+        for (const QueryWords* words : { &queries[index].plus_words, &queries[index].minus_words }) {
+            for (const std::string_view word : *words) {
+                if (resolved_terms.count(word) == 0) {
+                    resolved_terms.emplace(word, ResolveTerm(word));
+                }
+            }
         }
     }
-    return true;
+
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; };
+    const DocumentScorer scorer = GetScorer();
+    std::vector<std::vector<Document>> distinct_results(distinct_queries.size());
+    pool.ParallelFor(distinct_queries.size(), [&](size_t distinct_index) {
+        const size_t index = distinct_queries[distinct_index];
+        std::vector<Document>& documents = distinct_results[distinct_index];
+        if (result_cache_.Find(keys[index], generation_, documents)) {
+            return;
+        }
+        QueryTerms terms;
+        for (const std::string_view word : queries[index].plus_words) {
+            AppendQueryTerm(resolved_terms.at(word), false, terms);
+        }
+        for (const std::string_view word : queries[index].minus_words) {
+            AppendQueryTerm(resolved_terms.at(word), true, terms);
+        }
+        documents = scorer.FindTopDocuments(terms, predicate);
+        result_cache_.Insert(keys[index], generation_, documents);
+        });
+
+    std::vector<std::vector<Document>> results(query_count);
+    for (size_t index = 0; index < query_count; ++index) {
+        results[index] = distinct_results[query_distinct_indexes[index]];
+    }
+    return results;
+}
+
+DocumentScorer SearchServer::GetScorer() const {
+    const DocumentColumns columns{ document_ids_.data(), document_ratings_.data(), document_statuses_.data(),
+        document_lengths_.data(), static_cast<uint32_t>(document_ids_.size()), document_removed_.data() };
+    return DocumentScorer(columns, retrieval_mode_, max_result_document_count_);
 }
 
 std::set<int>::iterator SearchServer::begin() const {
@@ -248,27 +829,25 @@ std::set<int>::iterator SearchServer::end() const {
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-
-    const auto found = documents_.find(document_id);
-    if (found == documents_.end()) {
+    const auto found = document_ordinals_.find(document_id);
+    if (found == document_ordinals_.end()) {
         return;
     }
+    const uint32_t ordinal = found->second;
 
     IDs.erase(document_id);
+    document_ordinals_.erase(found);
 
-    std::map<int, DocumentData>::iterator element_to_delet = documents_.find(document_id);
-    documents_.erase(element_to_delet);
-
-    std::vector<std::string> words_to_del;
-
-    for (auto& [word, freqs] : id_word_to_freqs.at(document_id)) {
-        word_to_document_freqs_.at(as_string(word)).erase(document_id);
-        if (word_to_document_freqs_.at(as_string(word)).empty()) {
-            word_to_document_freqs_.erase(as_string(word));
-        }
+    if (duplicate_mode_ != DuplicateMode::ALLOW) {
+        RemoveDocumentSignature(ordinal);
     }
+    for (const auto [term_id, _] : forward_index_.GetTerms(ordinal)) {
+        --document_freqs_[term_id];
+        UpdateLogDocumentFreq(term_id);
+    }
+    UpdateLogDocumentCount();
 
-    id_word_to_freqs.erase(document_id);
+    MarkRemoved(ordinal);
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy seq, int document_id){
@@ -276,28 +855,426 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy seq, int docu
 }
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy par, int document_id) {
-    const auto found = documents_.find(document_id);
-    if (found == documents_.end()) {
+    const auto found = document_ordinals_.find(document_id);
+    if (found == document_ordinals_.end()) {
         return;
     }
+    const uint32_t ordinal = found->second;
 
     IDs.erase(document_id);
+    document_ordinals_.erase(found);
+
+    if (duplicate_mode_ != DuplicateMode::ALLOW) {
+        RemoveDocumentSignature(ordinal);
+    }
+    const ForwardIndex::TermRange document_terms = forward_index_.GetTerms(ordinal);
+    std::for_each(par, document_terms.begin(), document_terms.end(), [&](const TermCount& term_count) {
+        --document_freqs_[term_count.term_id];
+        UpdateLogDocumentFreq(term_count.term_id);
+    });
+    UpdateLogDocumentCount();
+
+    MarkRemoved(ordinal);
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const uint32_t ordinal = GetDocumentOrdinal(document_id);
+    return WordFrequencies(forward_index_.GetTerms(ordinal), document_lengths_[ordinal], terms_);
+}
+
+std::vector<int> SearchServer::FindDuplicateDocuments() const {
+    const std::vector<std::pair<int, uint32_t>> documents(document_ordinals_.begin(), document_ordinals_.end());
+    std::vector<DocumentSignature> signatures(documents.size());
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        signatures[index] = ComputeDocumentSignature(documents[index].second);
+        });
+
+    // Documents are visited by increasing id, so the first one of every set of terms is kept.
+    std::unordered_map<DocumentSignature, std::vector<uint32_t>, DocumentSignatureHasher> first_ordinals;
+    first_ordinals.reserve(documents.size());
+    std::vector<int> duplicates;
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const auto [document_id, ordinal] = documents[index];
+        std::vector<uint32_t>& same_signature = first_ordinals[signatures[index]];
+        const bool is_duplicate = std::any_of(same_signature.begin(), same_signature.end(), [this, ordinal = ordinal](uint32_t other) {
+            return HaveSameTerms(ordinal, other);
+            });
+        if (is_duplicate) {
+            duplicates.push_back(document_id);
+        }
+        else {
+            same_signature.push_back(ordinal);
+        }
+    }
+    return duplicates;
+}
 
-    std::map<int, DocumentData>::iterator element_to_delet = documents_.find(document_id);
-    documents_.erase(element_to_delet);
+std::vector<std::vector<int>> SearchServer::FindNearDuplicateDocuments(const NearDuplicateOptions& options) const {
+    // Checked here, an exception thrown by a builder inside the parallel loops would terminate.
+    if (options.band_count == 0 || options.rows_per_band == 0 || options.rows_per_band > MinHashBandBuilder::MAX_ROWS_PER_BAND) {
+        throw std::invalid_argument("Invalid number of bands or rows per band"s);
+    }
+    std::vector<uint32_t> ordinals;
+    ordinals.reserve(document_ordinals_.size());
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        ordinals.push_back(ordinal);
+    }
+    std::vector<size_t> indexes(ordinals.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
 
-    std::vector<std::string> words_to_del;
+    struct BucketEntry {
+        uint64_t key;
+        uint32_t index;
 
-    std::for_each(par, id_word_to_freqs.at(document_id).begin(), id_word_to_freqs.at(document_id).end(), [&](std::pair<const std::string_view, double>& pair_) {
-        word_to_document_freqs_.at(as_string(pair_.first)).erase(document_id);
-        if (word_to_document_freqs_.at(as_string(pair_.first)).empty()) {
-            word_to_document_freqs_.erase(as_string(pair_.first));
+        bool operator<(const BucketEntry& other) const {
+            return key < other.key || (key == other.key && index < other.index);
         }
-    });
+    };
+    std::vector<BucketEntry> bucket_entries(ordinals.size());
+    std::vector<std::pair<uint32_t, uint32_t>> candidates;
+    std::vector<uint8_t> is_similar;
+    DocumentClusters clusters(ordinals.size());
+
+    // The terms of a document are gathered once per pass of up to BANDS_PER_PASS bands, the keys
+    // of a pass take BANDS_PER_PASS words per document.
+    constexpr uint32_t BANDS_PER_PASS = 8;
+    std::vector<uint64_t> band_keys;
+    for (uint32_t band = 0; band < options.band_count; ++band) {
+        const uint32_t pass_band = band % BANDS_PER_PASS;
+        if (pass_band == 0) {
+            const uint32_t pass_band_count = std::min(BANDS_PER_PASS, options.band_count - band);
+            band_keys.resize(static_cast<size_t>(pass_band_count) * ordinals.size());
+            std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+                thread_local std::vector<uint32_t> term_ids;
+                term_ids.clear();
+                for (const auto [term_id, _] : forward_index_.GetTerms(ordinals[index])) {
+                    term_ids.push_back(term_id);
+                }
+                for (uint32_t offset = 0; offset < pass_band_count; ++offset) {
+                    MinHashBandBuilder builder(band + offset, options.rows_per_band);
+                    for (const uint32_t term_id : term_ids) {
+                        builder.Add(term_id);
+                    }
+                    band_keys[offset * ordinals.size() + index] = builder.GetKey();
+                }
+                });
+        }
+        for (size_t index = 0; index < ordinals.size(); ++index) {
+            bucket_entries[index] = { band_keys[pass_band * ordinals.size() + index], static_cast<uint32_t>(index) };
+        }
+        std::sort(std::execution::par, bucket_entries.begin(), bucket_entries.end());
+
+        // Every pair of a bucket is compared unless both documents are already in one cluster. A
+        // bucket larger than max_exact_bucket_size is mostly documents built from one template, its
+        // documents are compared only with the first one so that it costs one comparison each.
+        candidates.clear();
+        for (size_t begin = 0, end = 0; begin < bucket_entries.size(); begin = end) {
+            end = begin + 1;
+            while (end < bucket_entries.size() && bucket_entries[end].key == bucket_entries[begin].key) {
+                ++end;
+            }
+            const bool is_exact = end - begin <= options.max_exact_bucket_size;
+            for (size_t position = begin + 1; position < end; ++position) {
+                const uint32_t index = bucket_entries[position].index;
+                for (size_t other_position = begin; other_position < (is_exact ? position : begin + 1); ++other_position) {
+                    const uint32_t other_index = bucket_entries[other_position].index;
+                    if (clusters.Find(other_index) != clusters.Find(index)) {
+                        candidates.emplace_back(other_index, index);
+                    }
+                }
+            }
+        }
+        is_similar.assign(candidates.size(), 0);
+        std::vector<size_t> candidate_indexes(candidates.size());
+        std::iota(candidate_indexes.begin(), candidate_indexes.end(), 0);
+        std::for_each(std::execution::par, candidate_indexes.begin(), candidate_indexes.end(), [&](size_t candidate) {
+            const auto [first, index] = candidates[candidate];
+            is_similar[candidate] = ComputeJaccardSimilarity(ordinals[first], ordinals[index]) >= options.min_jaccard;
+            });
+        for (size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+            if (is_similar[candidate]) {
+                clusters.Unite(candidates[candidate].first, candidates[candidate].second);
+            }
+        }
+    }
 
-    id_word_to_freqs.erase(document_id);
+    // Indexes follow the order of ids, so walking them in order builds sorted clusters ordered by
+    // their first id.
+    std::vector<std::vector<int>> index_clusters(ordinals.size());
+    for (uint32_t index = 0; index < ordinals.size(); ++index) {
+        index_clusters[clusters.Find(index)].push_back(document_ids_[ordinals[index]]);
+    }
+    std::vector<std::vector<int>> result;
+    for (std::vector<int>& cluster : index_clusters) {
+        if (cluster.size() > 1) {
+            result.push_back(std::move(cluster));
+        }
+    }
+    return result;
+}
+
+void SearchServer::SetDuplicateMode(DuplicateMode mode) {
+    if (mode == DuplicateMode::ALLOW) {
+        signature_ordinals_.clear();
+    }
+    else if (duplicate_mode_ == DuplicateMode::ALLOW) {
+        std::vector<uint32_t> ordinals;
+        ordinals.reserve(document_ordinals_.size());
+        for (const auto [document_id, ordinal] : document_ordinals_) {
+            ordinals.push_back(ordinal);
+        }
+        std::vector<DocumentSignature> signatures(ordinals.size());
+        std::vector<size_t> indexes(ordinals.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+            signatures[index] = ComputeDocumentSignature(ordinals[index]);
+            });
+        for (size_t index = 0; index < ordinals.size(); ++index) {
+            signature_ordinals_[signatures[index]].push_back(ordinals[index]);
+        }
+    }
+    duplicate_mode_ = mode;
+}
+
+DuplicateMode SearchServer::GetDuplicateMode() const {
+    return duplicate_mode_;
+}
+
+std::vector<int> SearchServer::GetFlaggedDuplicates() const {
+    std::vector<int> duplicates;
+    for (const uint32_t ordinal : flagged_duplicate_ordinals_) {
+        if (!document_removed_[ordinal]) {
+            duplicates.push_back(document_ids_[ordinal]);
+        }
+    }
+    return duplicates;
+}
+
+DocumentSignature SearchServer::ComputeDocumentSignature(uint32_t ordinal) const {
+    DocumentSignatureBuilder builder;
+    for (const auto [term_id, _] : forward_index_.GetTerms(ordinal)) {
+        builder.Add(term_id);
+    }
+    return builder.Get();
+}
+
+DocumentSignature SearchServer::ComputeDocumentSignature(const std::vector<uint32_t>& sorted_term_ids) {
+    DocumentSignatureBuilder builder;
+    for (const uint32_t term_id : sorted_term_ids) {
+        builder.Add(term_id);
+    }
+    return builder.Get();
+}
+
+bool SearchServer::HaveSameTerms(uint32_t ordinal, uint32_t other_ordinal) const {
+    const ForwardIndex::TermRange terms = forward_index_.GetTerms(ordinal);
+    const ForwardIndex::TermRange other_terms = forward_index_.GetTerms(other_ordinal);
+    return std::equal(terms.begin(), terms.end(), other_terms.begin(), other_terms.end(), [](const TermCount& lhs, const TermCount& rhs) {
+        return lhs.term_id == rhs.term_id;
+        });
+}
+
+double SearchServer::ComputeJaccardSimilarity(uint32_t ordinal, uint32_t other_ordinal) const {
+    const ForwardIndex::TermRange terms = forward_index_.GetTerms(ordinal);
+    const ForwardIndex::TermRange other_terms = forward_index_.GetTerms(other_ordinal);
+    if (terms.size() == 0 && other_terms.size() == 0) {
+        return 1.0;
+    }
+    size_t common_count = 0;
+    auto it = terms.begin();
+    auto other_it = other_terms.begin();
+    while (it != terms.end() && other_it != other_terms.end()) {
+        if (it->term_id < other_it->term_id) {
+            ++it;
+        }
+        else if (other_it->term_id < it->term_id) {
+            ++other_it;
+        }
+        else {
+            ++common_count;
+            ++it;
+            ++other_it;
+        }
+    }
+    return static_cast<double>(common_count) / (terms.size() + other_terms.size() - common_count);
+}
+
+bool SearchServer::HasTerms(uint32_t ordinal, const std::vector<uint32_t>& sorted_term_ids) const {
+    const ForwardIndex::TermRange terms = forward_index_.GetTerms(ordinal);
+    return std::equal(terms.begin(), terms.end(), sorted_term_ids.begin(), sorted_term_ids.end(), [](const TermCount& term_count, uint32_t term_id) {
+        return term_count.term_id == term_id;
+        });
+}
+
+bool SearchServer::IsIndexedDuplicate(const DocumentSignature& signature, const std::vector<uint32_t>& sorted_term_ids) const {
+    const auto found = signature_ordinals_.find(signature);
+    return found != signature_ordinals_.end() && std::any_of(found->second.begin(), found->second.end(), [&](uint32_t ordinal) {
+        return HasTerms(ordinal, sorted_term_ids);
+        });
+}
+
+bool SearchServer::GetSortedTermIds(const TokenizedDocument& document, std::vector<uint32_t>& sorted_term_ids) const {
+    sorted_term_ids.clear();
+    for (const std::string_view word : document.words) {
+        const uint32_t term_id = terms_.Find(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            return false;
+        }
+        sorted_term_ids.push_back(term_id);
+    }
+    std::sort(sorted_term_ids.begin(), sorted_term_ids.end());
+    return true;
+}
+
+void SearchServer::AddDocumentSignature(uint32_t ordinal) {
+    signature_ordinals_[ComputeDocumentSignature(ordinal)].push_back(ordinal);
+}
+
+void SearchServer::RemoveDocumentSignature(uint32_t ordinal) {
+    const auto found = signature_ordinals_.find(ComputeDocumentSignature(ordinal));
+    if (found == signature_ordinals_.end()) {
+        return;
+    }
+    std::vector<uint32_t>& ordinals = found->second;
+    ordinals.erase(std::remove(ordinals.begin(), ordinals.end(), ordinal), ordinals.end());
+    if (ordinals.empty()) {
+        signature_ordinals_.erase(found);
+    }
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    return id_word_to_freqs.at(document_id);
+void SearchServer::MergeSegments() {
+    InstallMergedSegment(true);
+    SealMutableSegment();
+    const bool has_removed = std::any_of(segments_.begin(), segments_.end(), [](const SegmentEntry& entry) {
+        return entry.removed_document_count > 0;
+        });
+    if (segments_.size() > 1 || has_removed) {
+        std::vector<const IndexSegment*> sources;
+        for (const SegmentEntry& entry : segments_) {
+            sources.push_back(entry.segment.get());
+        }
+        const uint32_t begin_ordinal = segments_.front().segment->GetBeginOrdinal();
+        const std::vector<uint8_t> removed(document_removed_.begin() + begin_ordinal, document_removed_.end());
+        const std::vector<uint32_t> lengths(document_lengths_.begin() + begin_ordinal, document_lengths_.end());
+        segments_ = { { std::make_shared<const IndexSegment>(IndexSegment::Merge(sources, removed, lengths)), 0 } };
+    }
+    if (forward_index_.GetRemovedEntryCount() > 0) {
+        forward_index_.Compact(document_removed_);
+    }
+}
+
+size_t SearchServer::GetSegmentCount() const {
+    return segments_.size() + (mutable_begin_ordinal_ < document_ids_.size() ? 1 : 0);
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    const size_t term_count = terms_.GetTermCount();
+    const size_t ordinal_count = document_ids_.size();
+
+    // Rebuilt here rather than copied from the dictionary so that the file does not depend on
+    // its insertion history, only on TermDictionary::Hash.
+    size_t slot_count = 16;
+    while (slot_count * 7 <= term_count * 10) {
+        slot_count *= 2;
+    }
+    std::vector<SnapshotTermSlot> slots(slot_count, SnapshotTermSlot{ 0, TermDictionary::NO_TERM });
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        const uint32_t hash = TermDictionary::Hash(terms_.GetTerm(term_id));
+        size_t slot = hash & (slot_count - 1);
+        while (slots[slot].term_id != TermDictionary::NO_TERM) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = { hash, term_id };
+    }
+    writer.WriteSection(TERM_SLOTS, slots.data(), slots.size());
+
+    std::vector<uint64_t> term_offsets{ 0 };
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        term_offsets.push_back(term_offsets.back() + terms_.GetTerm(term_id).size());
+    }
+    writer.WriteSection(TERM_OFFSETS, term_offsets.data(), term_offsets.size());
+    writer.BeginSection(TERM_CHARS);
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        const std::string_view term = terms_.GetTerm(term_id);
+        writer.Write(term.data(), term.size());
+    }
+
+    // The snapshot holds a single segment without the postings of removed documents, so its
+    // contents do not depend on how the index happened to be segmented.
+    const IndexSegment mutable_segment = IndexSegment::Build(mutable_postings_, mutable_begin_ordinal_, static_cast<uint32_t>(ordinal_count));
+    std::vector<const IndexSegment*> sources;
+    for (const SegmentEntry& entry : segments_) {
+        sources.push_back(entry.segment.get());
+    }
+    sources.push_back(&mutable_segment);
+    const IndexSegment index = IndexSegment::Merge(sources, document_removed_, document_lengths_);
+
+    std::vector<SnapshotTerm> term_records(term_count, SnapshotTerm{});
+    uint64_t data_offset = 0;
+    uint32_t first_block = 0;
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        SnapshotTerm& record = term_records[term_id];
+        record.is_stop_word = term_id < stop_words_.size() && stop_words_[term_id];
+        const PostingListView postings = index.GetPostings(term_id);
+        record.data_offset = data_offset;
+        record.data_size = static_cast<uint32_t>(postings.GetDataSize());
+        record.first_block = first_block;
+        record.block_count = static_cast<uint32_t>(postings.GetBlockCount());
+        record.posting_count = static_cast<uint32_t>(postings.size());
+        record.max_term_freq = postings.GetMaxTermFreq();
+        data_offset += record.data_size;
+        first_block += record.block_count;
+    }
+    writer.WriteSection(TERMS, term_records.data(), term_records.size());
+    writer.BeginSection(POSTING_BLOCKS);
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        const PostingListView postings = index.GetPostings(term_id);
+        if (postings.GetBlockCount() > 0) {
+            writer.Write(&postings.GetBlockHeader(0), postings.GetBlockCount() * sizeof(PostingBlockHeader));
+        }
+    }
+    writer.BeginSection(POSTING_DATA);
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        const PostingListView postings = index.GetPostings(term_id);
+        writer.Write(postings.GetData(), postings.GetDataSize());
+    }
+
+    writer.WriteSection(DOCUMENT_IDS, document_ids_.data(), ordinal_count);
+    writer.WriteSection(DOCUMENT_RATINGS, document_ratings_.data(), ordinal_count);
+    writer.WriteSection(DOCUMENT_STATUSES, document_statuses_.data(), ordinal_count);
+    writer.WriteSection(DOCUMENT_LENGTHS, document_lengths_.data(), ordinal_count);
+
+    std::vector<int> live_ids;
+    std::vector<uint32_t> live_ordinals;
+    live_ids.reserve(document_ordinals_.size());
+    live_ordinals.reserve(document_ordinals_.size());
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        live_ids.push_back(document_id);
+        live_ordinals.push_back(ordinal);
+    }
+    writer.WriteSection(LIVE_DOCUMENT_IDS, live_ids.data(), live_ids.size());
+    writer.WriteSection(LIVE_DOCUMENT_ORDINALS, live_ordinals.data(), live_ordinals.size());
+
+    // Removed documents keep their terms in the forward index until it is compacted.
+    std::vector<uint64_t> word_count_offsets{ 0 };
+    for (uint32_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        word_count_offsets.push_back(word_count_offsets.back() + (document_removed_[ordinal] ? 0 : forward_index_.GetTerms(ordinal).size()));
+    }
+    writer.WriteSection(WORD_COUNT_OFFSETS, word_count_offsets.data(), word_count_offsets.size());
+    writer.BeginSection(WORD_COUNTS);
+    for (uint32_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (document_removed_[ordinal]) {
+            continue;
+        }
+        for (const auto [term_id, count] : forward_index_.GetTerms(ordinal)) {
+            const SnapshotWordCount record{ term_id, count };
+            writer.Write(&record, sizeof(record));
+        }
+    }
+
+    writer.Commit(static_cast<uint32_t>(term_count), static_cast<uint32_t>(slot_count),
+        static_cast<uint32_t>(ordinal_count), static_cast<uint32_t>(live_ids.size()));
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <string>
 #include <cassert>
 #include <set>
@@ -11,14 +12,76 @@
 #include <execution>
 #include <functional>
 #include <string_view>
+#include <thread>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <future>
+#include <memory>
 
 #include "document.h"
+#include "document_signature.h"
 #include "string_processing.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "document_scorer.h"
+#include "forward_index.h"
+#include "index_segment.h"
+#include "near_duplicates.h"
+#include "paginator.h"
+#include "posting_list.h"
+#include "query_words.h"
+#include "result_cache.h"
+#include "term_dictionary.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+class ThreadPool;
+
+// What AddDocument and AddDocuments do with a document whose set of words is exactly that of a
+// document already in the index.
+enum class DuplicateMode {
+    ALLOW,
+    // The document is added and listed by GetFlaggedDuplicates.
+    FLAG,
+    // invalid_argument is thrown and nothing is added.
+    REJECT,
+};
+
+struct NewDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// What the IDFs of a query depend on: the number of live documents and, for every distinct plus
+// word of the query in sorted order, the number of live documents that contain it. Statistics of
+// servers that partition one collection add up to the statistics of the whole collection.
+struct CollectionStatistics {
+    int document_count = 0;
+    std::vector<int> word_document_freqs;
+
+    void Merge(const CollectionStatistics& other);
+};
+
+// Matched words of a batch of documents, stored one document after another so that matching into
+// the same object again allocates nothing once its buffers have grown. The words are views into
+// the term dictionary of the server and stay valid while the server lives.
+struct MatchedDocuments {
+    std::vector<std::string_view> words;
+    // The words of the i-th document are words[word_offsets[i], word_offsets[i + 1]).
+    std::vector<size_t> word_offsets;
+    std::vector<DocumentStatus> statuses;
+
+    size_t size() const {
+        return statuses.size();
+    }
+
+    IteratorRange<std::vector<std::string_view>::const_iterator> GetWords(size_t index) const {
+        return IteratorRange(words.begin() + word_offsets[index], words.begin() + word_offsets[index + 1]);
+    }
+};
+
 class SearchServer {
 public:
     SearchServer() = default;
@@ -32,6 +95,11 @@ public:
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Adds a batch of documents using all cores. The batch is validated with the rules of
+    // AddDocument before anything is indexed, so either every document is added or none is, and
+    // the result is identical to adding the documents one by one in the same order.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
     template<typename Predicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate) const;
 
@@ -48,14 +116,58 @@ public:
     template<typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status_) const;
 
+    // Finds the top ACTUAL documents of every query of a batch on the threads of pool, the results
+    // are in the order of the queries. Queries that normalize to the same words are evaluated
+    // once and every distinct term is looked up once per batch.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, ThreadPool& pool) const;
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::vector<std::string>::const_iterator first, std::vector<std::string>::const_iterator last, ThreadPool& pool) const;
+
+    // The statistics of this server for the query, throws invalid_argument for an invalid query.
+    CollectionStatistics GetQueryStatistics(const std::string_view raw_query) const;
+
+    // Ranks with IDFs computed from statistics rather than from this server, which is how a server
+    // holding part of a collection ranks its documents as the whole collection would. Plus words
+    // with a document frequency of 0 in statistics are ignored. The results are not cached.
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const CollectionStatistics& statistics, Predicate predicate) const;
+
     int GetDocumentCount() const;
 
+    void SetMaxResultDocumentCount(size_t count);
+
+    size_t GetMaxResultDocumentCount() const;
+
+    void SetRetrievalMode(RetrievalMode mode);
+
+    RetrievalMode GetRetrievalMode() const;
+
+    // The results of the status overloads of FindTopDocuments are cached per normalized query,
+    // so word order and repeated words do not matter. The cache is off until a capacity is set,
+    // a capacity of 0 disables it again.
+    void SetResultCacheCapacity(size_t capacity);
+
+    ResultCacheStats GetResultCacheStats() const;
+
+    // Parses the query as FindTopDocuments does and returns how many distinct plus and minus
+    // words it has, throws invalid_argument for an invalid query. Lets parsing be measured apart
+    // from scoring.
+    size_t CountQueryWords(const std::string_view raw_query) const;
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy par, const std::string_view& raw_query, int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy seq, const std::string_view& raw_query, int document_id) const;
 
+    // Matches the query against every document of document_ids, the i-th result being what
+    // MatchDocument returns for the i-th id. The query is parsed and its words are looked up once
+    // for the whole batch. Unknown ids throw out_of_range before anything is matched.
+    MatchedDocuments MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    // Overwrites matches, reusing its buffers.
+    void MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids, MatchedDocuments& matches) const;
+
     std::set<int>::iterator begin() const;
 
     std::set<int>::iterator end() const;
@@ -66,60 +178,234 @@ public:
 
     void RemoveDocument(std::execution::sequenced_policy seq, int document_id);
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Views into the index that stay valid until the index changes.
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    // Documents whose set of words is the same as that of a document with a smaller id, in
+    // increasing order of ids. Signatures of the documents are computed on all cores and only
+    // documents with equal signatures are compared word by word.
+    std::vector<int> FindDuplicateDocuments() const;
+
+    // Clusters of documents whose sets of words have a Jaccard similarity of at least
+    // options.min_jaccard with another document of the cluster, found through MinHash LSH. Every
+    // cluster is in increasing order of ids and the clusters are ordered by their first id, so
+    // removing all but the first document of each cluster keeps one document per cluster. The
+    // bands are bucketed one after another, which keeps the memory linear in the document count.
+    std::vector<std::vector<int>> FindNearDuplicateDocuments(const NearDuplicateOptions& options = {}) const;
+
+    // Outside of ALLOW every new document is checked against the signatures of the documents in
+    // the index, which are kept up to date from then on.
+    void SetDuplicateMode(DuplicateMode mode);
+
+    DuplicateMode GetDuplicateMode() const;
+
+    // Documents added as duplicates in FLAG mode and not removed since, in the order of adding.
+    std::vector<int> GetFlaggedDuplicates() const;
+
+    // Waits for the background merge and compacts the whole index into one segment without the
+    // postings of removed documents, whose terms are dropped from the forward index as well.
+    void MergeSegments();
+
+    size_t GetSegmentCount() const;
+
+    // Writes the index in the binary format read by SnapshotSearchServer.
+    void SaveSnapshot(const std::string& path) const;
 
 private:
 
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // Distinct words of a query in sorted order, as views into the query text, which outlives
+    // the parsed query in every caller.
+    using Query = ParsedQuery;
+
+    // Distinct words of a document in the order of their first occurrence with their numbers of
+    // occurrences. The length counts every occurrence of a word that is not a stop word.
+    struct TokenizedDocument {
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> term_ids;
+        uint32_t length = 0;
+        bool is_valid = true;
+    };
+
+    // Term ids of the indexed words of a query in increasing order, the order of the forward index.
+    struct MatchQuery {
+        std::vector<uint32_t> plus_term_ids;
+        std::vector<uint32_t> minus_term_ids;
+    };
+
+    struct TermPosting {
+        uint32_t term_id;
+        uint32_t ordinal;
+        uint32_t term_count;
+        float term_freq;
+    };
+
+    // The postings of an indexed term in every segment, empty for other words.
+    struct ResolvedTerm {
+        std::vector<PostingListView> postings;
+        double inverse_document_freq = 0;
     };
 
-    struct QueryWord {
-        std::string_view data;
-        bool is_minus;
-        bool is_stop;
+    struct SegmentEntry {
+        std::shared_ptr<const IndexSegment> segment;
+        // Documents removed since the postings of the segment were built.
+        uint32_t removed_document_count;
     };
 
-    struct Query {
-        std::set<std::string, std::less<>> plus_words;
-        std::set<std::string, std::less<>> minus_words;
+    // A merge of segments_[first_segment, first_segment + segments.size()) running in the background.
+    struct PendingMerge {
+        size_t first_segment;
+        std::vector<std::shared_ptr<const IndexSegment>> segments;
+        uint32_t removed_document_count;
+        std::shared_future<std::shared_ptr<const IndexSegment>> result;
     };
 
-    std::set<std::string, std::less<>> stop_words_;
+    // The mutable segment is sealed once it holds this many ordinals.
+    static constexpr uint32_t MUTABLE_SEGMENT_DOCUMENT_COUNT = 4096;
+
+    // Segments of the same size tier are merged this many at a time.
+    static constexpr size_t SEGMENT_MERGE_FACTOR = 4;
+
+    TermDictionary terms_;
+
+    std::vector<bool> stop_words_;
+
+    std::map<int, uint32_t> document_ordinals_;
+
+    std::vector<int> document_ids_;
 
-    std::map<int, DocumentData> documents_;
+    std::vector<int> document_ratings_;
 
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
+    std::vector<DocumentStatus> document_statuses_;
 
-    std::map<int, std::map<std::string_view, double>> id_word_to_freqs;
+    // Term frequencies are stored as counts and divided by these lengths when they are read.
+    std::vector<uint32_t> document_lengths_;
+
+    std::vector<uint8_t> document_removed_;
+
+    // The index is a list of immutable segments in ordinal order followed by a mutable segment
+    // that takes new documents. Removing a document only marks its ordinal, the postings stay in
+    // place until a merge rewrites their segment.
+    std::vector<SegmentEntry> segments_;
+
+    std::vector<PostingList> mutable_postings_;
+
+    uint32_t mutable_begin_ordinal_ = 0;
+
+    std::shared_ptr<const PendingMerge> pending_merge_;
+
+    // Live documents that contain the term.
+    std::vector<uint32_t> document_freqs_;
+
+    // The IDF of a term is log_document_count_ - log_document_freqs_[term_id]. Both are updated
+    // by the changes that move them, so a query reads the IDF of a term without a log call and a
+    // change of the document count updates a single number rather than every term.
+    std::vector<double> log_document_freqs_;
+
+    double log_document_count_ = 0;
+
+    ForwardIndex forward_index_;
 
     std::set<int> IDs;
 
+    DuplicateMode duplicate_mode_ = DuplicateMode::ALLOW;
+
+    // Ordinals of the documents in the index by the signature of their terms, empty in ALLOW mode.
+    std::unordered_map<DocumentSignature, std::vector<uint32_t>, DocumentSignatureHasher> signature_ordinals_;
+
+    std::vector<uint32_t> flagged_duplicate_ordinals_;
+
+    // Bumped by every change that can affect query results, cached results of older generations
+    // are never returned.
+    uint64_t generation_ = 0;
+
+    mutable ResultCache result_cache_;
+
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+
+    RetrievalMode retrieval_mode_ = RetrievalMode::EXHAUSTIVE;
+
+    void AddStopWord(const std::string_view word);
+
     bool IsStopWord(const std::string_view& word) const;
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
+    uint32_t FindIndexedTerm(const std::string_view word) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    static void ValidateNewDocument(int document_id, bool is_duplicate, bool is_valid_text);
+
+    TokenizedDocument TokenizeDocument(const std::string_view text) const;
+
+    DocumentSignature ComputeDocumentSignature(uint32_t ordinal) const;
+
+    static DocumentSignature ComputeDocumentSignature(const std::vector<uint32_t>& sorted_term_ids);
+
+    bool HaveSameTerms(uint32_t ordinal, uint32_t other_ordinal) const;
+
+    double ComputeJaccardSimilarity(uint32_t ordinal, uint32_t other_ordinal) const;
+
+    bool HasTerms(uint32_t ordinal, const std::vector<uint32_t>& sorted_term_ids) const;
+
+    // Whether a document with these terms duplicates one in the signature table.
+    bool IsIndexedDuplicate(const DocumentSignature& signature, const std::vector<uint32_t>& sorted_term_ids) const;
+
+    // Fills sorted_term_ids with the term ids of a tokenized document in increasing order. Returns
+    // false if one of its words is not in the dictionary, such a document duplicates no other.
+    bool GetSortedTermIds(const TokenizedDocument& document, std::vector<uint32_t>& sorted_term_ids) const;
+
+    void AddDocumentSignature(uint32_t ordinal);
+
+    void RemoveDocumentSignature(uint32_t ordinal);
+
+    uint32_t GetDocumentOrdinal(int document_id) const;
+
+    void MarkRemoved(uint32_t ordinal);
+
+    std::vector<PostingListView> GetSegmentPostings(uint32_t term_id) const;
+
+    PostingListView GetSegmentPostings(uint32_t term_id, uint32_t ordinal) const;
+
+    void MaintainSegments();
+
+    void SealMutableSegment();
+
+    void ScheduleMerge();
+
+    void InstallMergedSegment(bool wait);
 
     Query ParseQuery(const std::string_view& text) const;
 
+    void ResolveMatchQuery(const Query& query, MatchQuery& match_query) const;
+
+    // Appends the words of the query found in the document in lexicographic order, or nothing if
+    // one of its minus words is found.
+    void MatchResolvedQuery(const MatchQuery& match_query, uint32_t ordinal, std::vector<std::string_view>& matched_words) const;
+
+    // Appends the terms of sorted_term_ids that the document has, in the order of their ids.
+    void IntersectDocumentTerms(uint32_t ordinal, const std::vector<uint32_t>& sorted_term_ids, std::vector<std::string_view>& matched_words) const;
+
+
+    double ComputeWordInverseDocumentFreq(uint32_t term_id) const;
+
+    void UpdateLogDocumentFreq(uint32_t term_id);
+
+    void UpdateLogDocumentCount();
+
+    static std::string GetResultCacheKey(const Query& query, DocumentStatus status);
+
     template <typename ExecutionPolicy>
-    Query ParseQuery(ExecutionPolicy&& policy, const std::string_view& text) const;
+    std::vector<Document> FindCachedTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    ResolvedTerm ResolveTerm(const std::string_view word) const;
 
-    template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const Query& query, Predicate predicate) const;
+    static void AppendQueryTerm(const ResolvedTerm& term, bool is_minus, QueryTerms& terms);
 
-    template <typename Predicate, typename ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy, const Query& query, Predicate predicate) const;
+    QueryTerms ResolveQueryTerms(const Query& query) const;
 
-    bool IsValidWord(const std::string& word) const;
+    QueryTerms ResolveQueryTerms(const Query& query, const CollectionStatistics& statistics) const;
 
-    bool IsValidWord(const std::string_view word) const;
+    DocumentScorer GetScorer() const;
 };
 
 template<typename StringCollection>
@@ -129,163 +415,62 @@ SearchServer::SearchServer(const StringCollection& stop_words) {
         if (!IsValidWord(word)) {
             throw std::invalid_argument(" Invalid symbol in "s + word + " word"s);
         };
-        stop_words_.insert(word);
+        AddStopWord(word);
     }
 }
 
-template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predicate predicate) const {
-    using namespace std::string_literals;
-
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(as_string(word));
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(as_string(word))) {
-            if (predicate(document_id, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
-        }
-    }
-
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(as_string(word))) {
-            document_to_relevance.erase(document_id);
-        }
-    }
-
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({
-            document_id,
-            relevance,
-            documents_.at(document_id).rating
-            });
-    }
-    return matched_documents;
-}
-
-template <typename Predicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, Predicate predicate) const {
-    using namespace std::string_literals;
-
-    ConcurrentMap<int, double> document_to_relevance(8);
-
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [&](const auto& word) {
-        if (word_to_document_freqs_.count(as_string(word)) != 0) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(as_string(word));
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(as_string(word))) {
-                if (predicate(document_id, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }
-        }
-        });
-
-    std::map<int, double> map_document_to_relevance = document_to_relevance.BuildOrdinaryMap();
-
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(as_string(word)) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(as_string(word))) {
-            map_document_to_relevance.erase(document_id);
-        }
-    }
-
-    std::vector<Document> matched_documents;
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
 
-    for (const auto [document_id, relevance] : map_document_to_relevance) {
-        matched_documents.push_back({
-            document_id,
-            relevance,
-            documents_.at(document_id).rating
-            });
-    }
-    return matched_documents;
+    const Query query = ParseQuery(raw_query);
+    const QueryTerms terms = ResolveQueryTerms(query);
+    return GetScorer().FindTopDocuments(terms, predicate);
 }
 
 template<typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
-
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const CollectionStatistics& statistics, Predicate predicate) const {
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, predicate);
-
-    std::sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    const QueryTerms terms = ResolveQueryTerms(query, statistics);
+    return GetScorer().FindTopDocuments(terms, predicate);
 }
 
 template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
-    return FindTopDocuments(policy, raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+    return FindCachedTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
 template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status_) const {
-    return FindTopDocuments(policy, raw_query, [status_](int document_id, DocumentStatus status, int rating) { return status == status_; });
+    return FindCachedTopDocuments(policy, raw_query, status_);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindCachedTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const {
+    const Query query = ParseQuery(raw_query);
+    const auto predicate = [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; };
+    // The key is a string built from every word, without a cache it is not built at all.
+    if (result_cache_.GetCapacity() == 0) {
+        return GetScorer().FindTopDocuments(policy, ResolveQueryTerms(query), predicate);
+    }
+    const std::string key = GetResultCacheKey(query, status);
+    std::vector<Document> documents;
+    if (result_cache_.Find(key, generation_, documents)) {
+        return documents;
+    }
+    const QueryTerms terms = ResolveQueryTerms(query);
+    documents = GetScorer().FindTopDocuments(policy, terms, predicate);
+    result_cache_.Insert(key, generation_, documents);
+    return documents;
 }
 
 template<typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, Predicate predicate) const {
-
-    const Query query = ParseQuery(policy, raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, predicate);
-
-    std::sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        return FindTopDocuments(raw_query, predicate);
+    }
+    else {
+        const Query query = ParseQuery(raw_query);
+        const QueryTerms terms = ResolveQueryTerms(query);
+        return GetScorer().FindTopDocuments(policy, terms, predicate);
     }
-    return matched_documents;
 }
-
-template<typename ExecutionPolicy>
-SearchServer::Query SearchServer::ParseQuery(ExecutionPolicy&& policy, const std::string_view& text) const {
-    Query query;
-
-    auto words = SplitIntoWords(text);
-
-    const auto combine_queries = [](Query first, Query second) {
-        first.minus_words.insert(make_move_iterator(second.minus_words.begin()), make_move_iterator(second.minus_words.end()));
-        first.plus_words.insert(make_move_iterator(second.plus_words.begin()), make_move_iterator(second.plus_words.end()));
-        return first;
-    };
-
-    return std::transform_reduce(policy, std::make_move_iterator(words.begin()), std::make_move_iterator(words.end()), Query{}, combine_queries, [&query, this](const auto& word) {
-        const QueryWord query_word = this->ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.insert(as_string(query_word.data));
-            }
-            else {
-                query.plus_words.insert(as_string(query_word.data));
-            }
-        }
-        return query;
-        }
-    );
-
-}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+ShardedSearchServer::ShardedSearchServer(const std::string_view stop_words, size_t shard_count) {
+    // The servers are built before any worker starts, so invalid stop words leave nothing running.
+    shards_.reserve(std::max<size_t>(shard_count, 1));
+    for (size_t shard_index = 0; shard_index < std::max<size_t>(shard_count, 1); ++shard_index) {
+        shards_.push_back(std::make_unique<Shard>(stop_words));
+    }
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+        shard->thread = std::thread([&shard = *shard]() {
+            WorkerLoop(shard);
+            });
+    }
+}
+
+ShardedSearchServer::~ShardedSearchServer() {
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+        {
+            std::lock_guard guard(shard->mutex);
+            shard->is_stopping = true;
+        }
+        shard->wake_up.notify_one();
+    }
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+        shard->thread.join();
+    }
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    const size_t shard_index = GetShardIndex(document_id);
+    Submit(shard_index, [&shard = *shards_[shard_index], document_id, document, status, &ratings](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+        shard.document_count.store(server.GetDocumentCount(), std::memory_order_relaxed);
+        }).get();
+}
+
+void ShardedSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    std::vector<std::vector<NewDocument>> shard_documents(shards_.size());
+    for (const NewDocument& document : documents) {
+        shard_documents[GetShardIndex(document.id)].push_back(document);
+    }
+
+    std::vector<std::future<void>> futures;
+    for (size_t shard_index = 0; shard_index < shards_.size(); ++shard_index) {
+        if (shard_documents[shard_index].empty()) {
+            continue;
+        }
+        futures.push_back(Submit(shard_index, [&shard = *shards_[shard_index], &documents = shard_documents[shard_index]](SearchServer& server) {
+            server.AddDocuments(documents);
+            shard.document_count.store(server.GetDocumentCount(), std::memory_order_relaxed);
+            }));
+    }
+    GetAll(futures);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    const size_t shard_index = GetShardIndex(document_id);
+    Submit(shard_index, [&shard = *shards_[shard_index], document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+        shard.document_count.store(server.GetDocumentCount(), std::memory_order_relaxed);
+        }).get();
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status_) const {
+    return FindTopDocuments(raw_query, [status_](int document_id, DocumentStatus status, int rating) { return status == status_; });
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    return Submit(GetShardIndex(document_id), [raw_query, document_id](const SearchServer& server) {
+        return server.MatchDocument(raw_query, document_id);
+        }).get();
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+        document_count += shard->document_count.load(std::memory_order_relaxed);
+    }
+    return document_count;
+}
+
+void ShardedSearchServer::SetMaxResultDocumentCount(size_t count) {
+    RunOnAllShards([count](SearchServer& server) {
+        server.SetMaxResultDocumentCount(count);
+        });
+    max_result_document_count_.store(count, std::memory_order_relaxed);
+}
+
+size_t ShardedSearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_.load(std::memory_order_relaxed);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Multiplicative hashing spreads runs of consecutive ids, the high bits of the product then
+    // pick the shard without a division.
+    const uint32_t hash = static_cast<uint32_t>(document_id) * 0x9E3779B1u;
+    return static_cast<size_t>((uint64_t{ hash } * shards_.size()) >> 32);
+}
+
+void ShardedSearchServer::WorkerLoop(Shard& shard) {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(shard.mutex);
+            shard.wake_up.wait(lock, [&shard]() {
+                return shard.is_stopping || !shard.tasks.empty();
+            });
+            if (shard.tasks.empty()) {
+                return;
+            }
+            task = std::move(shard.tasks.front());
+            shard.tasks.pop_front();
+        }
+        // Exceptions are stored in the future of the task.
+        task();
+    }
+}
+
+void ShardedSearchServer::GetAll(std::vector<std::future<void>>& futures) {
+    for (std::future<void>& future : futures) {
+        future.wait();
+    }
+    for (std::future<void>& future : futures) {
+        future.get();
+    }
+}
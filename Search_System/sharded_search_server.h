@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+// Partitions the documents across shards by a hash of their ids. Every shard is a SearchServer
+// owned by a worker thread of its own, which runs all the operations on it one after another, so
+// a shard needs no locks and updates of different shards never wait for each other. Queries are
+// scattered to every shard and their top documents are gathered into one top.
+//
+// Relevance is computed with the IDFs of the whole collection, so without concurrent updates the
+// results are those of a single SearchServer holding every document. A query that runs alongside
+// updates may see an update in some shards and not yet in others. It ranks with the statistics
+// gathered in its first round, so a word that no document had then is ignored even if a shard has
+// indexed it before the second round.
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(const std::string_view stop_words, size_t shard_count = std::thread::hardware_concurrency());
+
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    // Runs the operations already queued for the shards before stopping their workers.
+    ~ShardedSearchServer();
+
+    size_t GetShardCount() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Every shard adds its part of the batch with SearchServer::AddDocuments, all shards at once.
+    // A part is added entirely or not at all, but when one part throws the others may be added.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status_) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    void SetMaxResultDocumentCount(size_t count);
+
+    size_t GetMaxResultDocumentCount() const;
+
+private:
+    // Padded to a cache line so that the queues and counters of neighbouring shards do not
+    // false-share.
+    struct alignas(64) Shard {
+        explicit Shard(const std::string_view stop_words)
+            : server(stop_words)
+        {}
+
+        SearchServer server;
+        // Stored by the worker after every update, so reading the total does not go through the workers.
+        std::atomic<int> document_count{ 0 };
+        std::mutex mutex;
+        std::condition_variable wake_up;
+        std::deque<std::function<void()>> tasks;
+        bool is_stopping = false;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    // Written by SetMaxResultDocumentCount while queries read it, a query that overlaps the change
+    // may be cut to either count.
+    std::atomic<size_t> max_result_document_count_{ MAX_RESULT_DOCUMENT_COUNT };
+
+    size_t GetShardIndex(int document_id) const;
+
+    static void WorkerLoop(Shard& shard);
+
+    // Queues function(server) on the worker of the shard.
+    template <typename Function>
+    std::future<std::invoke_result_t<Function&, SearchServer&>> Submit(size_t shard_index, Function function) const;
+
+    // Runs function(server) on every shard at once and returns the results in shard order.
+    template <typename Function>
+    auto RunOnAllShards(const Function& function) const;
+
+    // Waits for every future before the first exception is rethrown, so that no task still uses
+    // the arguments of the caller once it has returned.
+    template <typename Result>
+    static std::vector<Result> GetAll(std::vector<std::future<Result>>& futures);
+
+    static void GetAll(std::vector<std::future<void>>& futures);
+};
+
+template <typename Function>
+std::future<std::invoke_result_t<Function&, SearchServer&>> ShardedSearchServer::Submit(size_t shard_index, Function function) const {
+    using Result = std::invoke_result_t<Function&, SearchServer&>;
+    Shard& shard = *shards_[shard_index];
+    // std::function needs a copyable target, the task is shared to satisfy it.
+    auto task = std::make_shared<std::packaged_task<Result()>>([&shard, function = std::move(function)]() mutable {
+        return function(shard.server);
+        });
+    std::future<Result> result = task->get_future();
+    {
+        std::lock_guard guard(shard.mutex);
+        shard.tasks.push_back([task]() {
+            (*task)();
+            });
+    }
+    shard.wake_up.notify_one();
+    return result;
+}
+
+template <typename Function>
+auto ShardedSearchServer::RunOnAllShards(const Function& function) const {
+    std::vector<std::future<std::invoke_result_t<const Function&, SearchServer&>>> futures;
+    futures.reserve(shards_.size());
+    for (size_t shard_index = 0; shard_index < shards_.size(); ++shard_index) {
+        futures.push_back(Submit(shard_index, function));
+    }
+    return GetAll(futures);
+}
+
+template <typename Result>
+std::vector<Result> ShardedSearchServer::GetAll(std::vector<std::future<Result>>& futures) {
+    for (std::future<Result>& future : futures) {
+        future.wait();
+    }
+    std::vector<Result> results;
+    results.reserve(futures.size());
+    for (std::future<Result>& future : futures) {
+        results.push_back(future.get());
+    }
+    return results;
+}
+
+template<typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
+    // Two rounds: the shards report how many of their documents contain the words of the query,
+    // then rank their documents with the sums, which are the statistics of the whole collection.
+    CollectionStatistics statistics;
+    for (const CollectionStatistics& shard_statistics : RunOnAllShards([raw_query](const SearchServer& server) {
+        return server.GetQueryStatistics(raw_query);
+        })) {
+        statistics.Merge(shard_statistics);
+    }
+
+    // Every shard returns its own top, which holds every document of the global top it owns.
+    TopDocuments top_documents(max_result_document_count_.load(std::memory_order_relaxed));
+    for (const std::vector<Document>& documents : RunOnAllShards([raw_query, &statistics, &predicate](const SearchServer& server) {
+        return server.FindTopDocuments(raw_query, statistics, predicate);
+        })) {
+        for (const Document& document : documents) {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
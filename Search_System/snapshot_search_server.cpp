@@ -0,0 +1,134 @@
+#include "snapshot_search_server.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "string_processing.h"
+#include "term_dictionary.h"
+
+using namespace std::string_literals;
+
+SnapshotSearchServer::SnapshotSearchServer(const std::string& path, SnapshotVerification verification)
+    : snapshot_(path, verification)
+{
+    log_document_count_ = GetDocumentCount() > 0 ? std::log(GetDocumentCount()) : 0.0;
+}
+
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+}
+
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status_) const {
+    return FindTopDocuments(raw_query, [status_](int document_id, DocumentStatus status, int rating) { return status == status_; });
+}
+
+int SnapshotSearchServer::GetDocumentCount() const {
+    return static_cast<int>(snapshot_.GetDocumentCount());
+}
+
+void SnapshotSearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+}
+
+size_t SnapshotSearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+void SnapshotSearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+}
+
+RetrievalMode SnapshotSearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SnapshotSearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
+    const uint32_t ordinal = GetDocumentOrdinal(document_id);
+    const DocumentStatus status = snapshot_.GetDocumentColumns().statuses[ordinal];
+
+    if (!IsValidWord(raw_query)) {
+        throw std::invalid_argument("Invalid symbol in query for document "s + std::to_string(document_id));
+    }
+
+    const Query query = ParseQuery(raw_query);
+
+    std::vector<std::string_view> matched_words;
+
+    for (const std::string_view word : query.minus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        if (term_id != TermDictionary::NO_TERM && snapshot_.GetPostings(term_id).Contains(ordinal)) {
+            return { matched_words, status };
+        }
+    }
+
+    for (const std::string_view word : query.plus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        if (term_id != TermDictionary::NO_TERM && snapshot_.GetPostings(term_id).Contains(ordinal)) {
+            matched_words.push_back(snapshot_.GetTerm(term_id));
+        }
+    }
+
+    return { matched_words, status };
+}
+
+const int* SnapshotSearchServer::begin() const {
+    return snapshot_.GetLiveDocumentIds();
+}
+
+const int* SnapshotSearchServer::end() const {
+    return snapshot_.GetLiveDocumentIds() + snapshot_.GetDocumentCount();
+}
+
+std::map<std::string_view, double> SnapshotSearchServer::GetWordFrequencies(int document_id) const {
+    const uint32_t ordinal = GetDocumentOrdinal(document_id);
+    const double inverse_length = 1.0 / snapshot_.GetDocumentColumns().lengths[ordinal];
+    std::map<std::string_view, double> word_frequencies;
+    for (const SnapshotWordCount* it = snapshot_.GetWordCountsBegin(ordinal); it != snapshot_.GetWordCountsEnd(ordinal); ++it) {
+        word_frequencies.emplace(snapshot_.GetTerm(it->term_id), it->count * inverse_length);
+    }
+    return word_frequencies;
+}
+
+uint32_t SnapshotSearchServer::GetDocumentOrdinal(int document_id) const {
+    const uint32_t ordinal = snapshot_.FindDocumentOrdinal(document_id);
+    if (ordinal == IndexSnapshot::NO_ORDINAL) {
+        throw std::out_of_range("Not found document id");
+    }
+    return ordinal;
+}
+
+uint32_t SnapshotSearchServer::FindIndexedTerm(const std::string_view word) const {
+    const uint32_t term_id = snapshot_.FindTerm(word);
+    if (term_id == TermDictionary::NO_TERM || snapshot_.GetPostings(term_id).empty()) {
+        return TermDictionary::NO_TERM;
+    }
+    return term_id;
+}
+
+SnapshotSearchServer::Query SnapshotSearchServer::ParseQuery(const std::string_view text) const {
+    return ParseQueryWords(text, [this](const std::string_view word) {
+        return snapshot_.IsStopWord(snapshot_.FindTerm(word));
+        });
+}
+
+QueryTerms SnapshotSearchServer::ResolveQueryTerms(const Query& query) const {
+    QueryTerms terms;
+    for (const std::string_view word : query.plus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            const PostingListView postings = snapshot_.GetPostings(term_id);
+            terms.plus_terms.push_back({ postings, log_document_count_ - std::log(postings.size()) });
+        }
+    }
+    for (const std::string_view word : query.minus_words) {
+        const uint32_t term_id = FindIndexedTerm(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            terms.minus_terms.push_back(snapshot_.GetPostings(term_id));
+        }
+    }
+    return terms;
+}
+
+DocumentScorer SnapshotSearchServer::GetScorer() const {
+    return DocumentScorer(snapshot_.GetDocumentColumns(), retrieval_mode_, max_result_document_count_);
+}
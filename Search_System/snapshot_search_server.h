@@ -0,0 +1,102 @@
+#pragma once
+
+#include <execution>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "document.h"
+#include "document_scorer.h"
+#include "index_snapshot.h"
+#include "query_words.h"
+#include "search_server.h"
+
+// Read-only search server that answers queries straight from a snapshot written by
+// SearchServer::SaveSnapshot. Nothing is deserialized: the term table, postings and attribute
+// columns are used in place in the mapped file, so opening even a large index takes constant time
+// and the pages are shared by all processes that serve the same file.
+class SnapshotSearchServer {
+public:
+    explicit SnapshotSearchServer(const std::string& path, SnapshotVerification verification = SnapshotVerification::FULL);
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status_) const;
+
+    template<typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, Predicate predicate) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status_) const;
+
+    int GetDocumentCount() const;
+
+    void SetMaxResultDocumentCount(size_t count);
+
+    size_t GetMaxResultDocumentCount() const;
+
+    void SetRetrievalMode(RetrievalMode mode);
+
+    RetrievalMode GetRetrievalMode() const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
+
+    const int* begin() const;
+
+    const int* end() const;
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+private:
+    using Query = ParsedQuery;
+
+    IndexSnapshot snapshot_;
+
+    // Split from the IDF the same way as in SearchServer, so both give bit-identical relevance.
+    double log_document_count_ = 0;
+
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+
+    RetrievalMode retrieval_mode_ = RetrievalMode::EXHAUSTIVE;
+
+    uint32_t GetDocumentOrdinal(int document_id) const;
+
+    uint32_t FindIndexedTerm(const std::string_view word) const;
+
+    Query ParseQuery(const std::string_view text) const;
+
+    QueryTerms ResolveQueryTerms(const Query& query) const;
+
+    DocumentScorer GetScorer() const;
+};
+
+template<typename Predicate>
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
+    const QueryTerms terms = ResolveQueryTerms(ParseQuery(raw_query));
+    return GetScorer().FindTopDocuments(terms, predicate);
+}
+
+template<typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, Predicate predicate) const {
+    const QueryTerms terms = ResolveQueryTerms(ParseQuery(raw_query));
+    return GetScorer().FindTopDocuments(policy, terms, predicate);
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status_) const {
+    return FindTopDocuments(policy, raw_query, [status_](int document_id, DocumentStatus status, int rating) { return status == status_; });
+}
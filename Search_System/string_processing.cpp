@@ -1,25 +1,116 @@
 #include "string_processing.h"
 
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SEARCH_SYSTEM_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
+namespace {
+    int CountTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    // Bytes below a space are control characters whether char is signed or not.
+    bool IsControl(char c) {
+        return static_cast<unsigned char>(c) < ' ';
+    }
+
+    // Emits the words that end at the spaces of a block, bit i of space_mask is set when
+    // text[block_begin + i] is a space.
+    void AppendBlockWords(std::string_view text, size_t block_begin, uint32_t space_mask, size_t& word_begin, std::vector<std::string_view>& words) {
+        while (space_mask != 0) {
+            const size_t space = block_begin + CountTrailingZeros(space_mask);
+            if (space > word_begin) {
+                words.push_back(text.substr(word_begin, space - word_begin));
+            }
+            word_begin = space + 1;
+            space_mask &= space_mask - 1;
+        }
+    }
+}
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
     std::vector<std::string_view> words;
+    SplitIntoValidWords(text, words);
+    return words;
+}
 
-    while (true) {
-        size_t space = text.find(' ');
-        words.push_back(text.substr(0u, space));
-        if (space == text.npos) {
-            break;
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view>& words) {
+    const char* const data = text.data();
+    size_t position = 0;
+    size_t word_begin = 0;
+    bool is_valid = true;
+
+    // A block is compared with spaces and with the largest control character at once, the masks
+    // then give the word boundaries without looking at the bytes again.
+#if defined(__AVX2__)
+    const __m256i spaces_256 = _mm256_set1_epi8(' ');
+    const __m256i last_control_256 = _mm256_set1_epi8(' ' - 1);
+    for (; position + 32 <= text.size(); position += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+        const __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(block, last_control_256), block);
+        if (_mm256_movemask_epi8(is_control) != 0) {
+            is_valid = false;
         }
-        else {
-            text.remove_prefix(space + 1);
+        AppendBlockWords(text, position, static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, spaces_256))), word_begin, words);
+    }
+#endif
+#if defined(SEARCH_SYSTEM_SSE2)
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(' ' - 1);
+    for (; position + 16 <= text.size(); position += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        const __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(block, last_control), block);
+        if (_mm_movemask_epi8(is_control) != 0) {
+            is_valid = false;
         }
+        AppendBlockWords(text, position, static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, spaces))), word_begin, words);
     }
+#endif
 
-    return words;
+    for (; position < text.size(); ++position) {
+        if (data[position] == ' ') {
+            if (position > word_begin) {
+                words.push_back(text.substr(word_begin, position - word_begin));
+            }
+            word_begin = position + 1;
+        }
+        else if (IsControl(data[position])) {
+            is_valid = false;
+        }
+    }
+    if (text.size() > word_begin) {
+        words.push_back(text.substr(word_begin));
+    }
+    return is_valid;
+}
+
+bool IsValidWord(std::string_view text) {
+    for (const char c : text) {
+        if (IsControl(c)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 std::string as_string(std::string_view v) {
     return { v.data(), v.size() };
-}
\ No newline at end of file
+}
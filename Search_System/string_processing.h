@@ -4,6 +4,16 @@
 #include <vector>
 #include <string_view>
 
+// Words of text separated by spaces. Repeated, leading and trailing spaces do not produce empty
+// words.
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
-std::string as_string(std::string_view v);
\ No newline at end of file
+// Appends the words of text to words, which callers reuse between texts, and checks text for
+// control characters in the same pass. Returns false if it has any, the words are split the same
+// way either way.
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view>& words);
+
+// Whether text has no control characters, the rule SplitIntoValidWords checks.
+bool IsValidWord(std::string_view text);
+
+std::string as_string(std::string_view v);
@@ -0,0 +1,119 @@
+#include "term_dictionary.h"
+
+#include <cstring>
+
+namespace {
+    constexpr size_t INITIAL_SLOT_COUNT = 16;
+}
+
+TermDictionary::TermDictionary()
+    : slots_(INITIAL_SLOT_COUNT, Slot{ 0, NO_TERM })
+{}
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : slots_(other.slots_)
+{
+    terms_.reserve(other.terms_.size());
+    for (const std::string_view term : other.terms_) {
+        terms_.push_back(StoreTerm(term));
+    }
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        TermDictionary copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+uint32_t TermDictionary::Find(std::string_view term) const {
+    return slots_[FindSlot(term, Hash(term))].term_id;
+}
+
+uint32_t TermDictionary::Insert(std::string_view term) {
+    const uint32_t hash = Hash(term);
+    size_t slot = FindSlot(term, hash);
+    if (slots_[slot].term_id != NO_TERM) {
+        return slots_[slot].term_id;
+    }
+
+    // Keep the load factor below 0.7 so that linear probing stays short.
+    if ((terms_.size() + 1) * 10 > slots_.size() * 7) {
+        Rehash(slots_.size() * 2);
+        slot = FindSlot(term, hash);
+    }
+
+    const uint32_t term_id = static_cast<uint32_t>(terms_.size());
+    terms_.push_back(StoreTerm(term));
+    slots_[slot] = { hash, term_id };
+    return term_id;
+}
+
+std::string_view TermDictionary::GetTerm(uint32_t term_id) const {
+    return terms_.at(term_id);
+}
+
+size_t TermDictionary::GetTermCount() const {
+    return terms_.size();
+}
+
+uint32_t TermDictionary::Hash(std::string_view term) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char c : term) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+size_t TermDictionary::FindSlot(std::string_view term, uint32_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const Slot& candidate = slots_[slot];
+        if (candidate.term_id == NO_TERM) {
+            return slot;
+        }
+        if (candidate.hash == hash && terms_[candidate.term_id] == term) {
+            return slot;
+        }
+    }
+}
+
+std::string_view TermDictionary::StoreTerm(std::string_view term) {
+    if (term.empty()) {
+        return {};
+    }
+    if (term.size() > ARENA_BLOCK_SIZE / 4) {
+        // Long terms get a block of their own so they do not waste the tail of the current block.
+        char* dst = arena_blocks_.emplace_back(new char[term.size()]).get();
+        std::memcpy(dst, term.data(), term.size());
+        return { dst, term.size() };
+    }
+    if (term.size() > arena_block_free_) {
+        arena_cursor_ = arena_blocks_.emplace_back(new char[ARENA_BLOCK_SIZE]).get();
+        arena_block_free_ = ARENA_BLOCK_SIZE;
+    }
+    char* dst = arena_cursor_;
+    std::memcpy(dst, term.data(), term.size());
+    arena_cursor_ += term.size();
+    arena_block_free_ -= term.size();
+    return { dst, term.size() };
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    std::vector<Slot> slots(slot_count, Slot{ 0, NO_TERM });
+    const size_t mask = slot_count - 1;
+    for (const Slot& slot : slots_) {
+        if (slot.term_id == NO_TERM) {
+            continue;
+        }
+        size_t pos = slot.hash & mask;
+        while (slots[pos].term_id != NO_TERM) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = slot;
+    }
+    slots_ = std::move(slots);
+}
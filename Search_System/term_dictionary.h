@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Interns every term once and maps it to a dense id. Term ids are assigned in insertion order
+// and never change, so they can index plain vectors. Views returned by GetTerm stay valid for the
+// lifetime of the dictionary: terms are stored in fixed-size arena blocks that are never moved.
+class TermDictionary {
+public:
+    static constexpr uint32_t NO_TERM = UINT32_MAX;
+
+    TermDictionary();
+
+    TermDictionary(const TermDictionary& other);
+
+    TermDictionary(TermDictionary&& other) noexcept = default;
+
+    TermDictionary& operator=(const TermDictionary& other);
+
+    TermDictionary& operator=(TermDictionary&& other) noexcept = default;
+
+    uint32_t Find(std::string_view term) const;
+
+    uint32_t Insert(std::string_view term);
+
+    std::string_view GetTerm(uint32_t term_id) const;
+
+    size_t GetTermCount() const;
+
+    // The hash used by the slot table, index snapshots store their own table built with it.
+    static uint32_t Hash(std::string_view term);
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t term_id;
+    };
+
+    static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+    std::vector<Slot> slots_;
+
+    std::vector<std::string_view> terms_;
+
+    std::vector<std::unique_ptr<char[]>> arena_blocks_;
+
+    char* arena_cursor_ = nullptr;
+
+    size_t arena_block_free_ = 0;
+
+    size_t FindSlot(std::string_view term, uint32_t hash) const;
+
+    std::string_view StoreTerm(std::string_view term);
+
+    void Rehash(size_t slot_count);
+};
@@ -0,0 +1,134 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : queues_(std::max<size_t>(thread_count, 1))
+{
+    threads_.reserve(queues_.size());
+    for (size_t queue_index = 0; queue_index < queues_.size(); ++queue_index) {
+        threads_.emplace_back([this, queue_index]() {
+            WorkerLoop(queue_index);
+            });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    wake_up_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return threads_.size();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    struct Batch {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr exception;
+    };
+    Batch batch;
+    batch.remaining = count;
+
+    // Consecutive indexes go to the same queue, the owner then runs them in order and thieves
+    // take the far end of the range.
+    for (size_t index = 0; index < count; ++index) {
+        Push(index * queues_.size() / count, [&batch, &task, index]() {
+            try {
+                task(index);
+            }
+            catch (...) {
+                std::lock_guard guard(batch.mutex);
+                if (!batch.exception) {
+                    batch.exception = std::current_exception();
+                }
+            }
+            // Counted down under the lock: once the waiting thread has seen zero and taken the
+            // lock itself, no task touches the batch any more.
+            std::lock_guard guard(batch.mutex);
+            if (batch.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                batch.done.notify_all();
+            }
+            });
+    }
+
+    while (batch.remaining.load(std::memory_order_acquire) > 0) {
+        if (TryRunTask(0)) {
+            continue;
+        }
+        // Every task is taken, the last ones are running on the workers.
+        std::unique_lock lock(batch.mutex);
+        batch.done.wait(lock, [&batch]() {
+            return batch.remaining.load(std::memory_order_acquire) == 0;
+            });
+    }
+
+    std::lock_guard guard(batch.mutex);
+    if (batch.exception) {
+        std::rethrow_exception(batch.exception);
+    }
+}
+
+void ThreadPool::Push(size_t queue_index, Task task) {
+    // Counted before the task can be taken: the increment happens before the push, which happens
+    // before the pop that counts the task down, so the count never drops below zero. A worker
+    // that sees the count before the task only retries until the push is done.
+    {
+        std::lock_guard guard(sleep_mutex_);
+        queued_task_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard guard(queues_[queue_index].mutex);
+        queues_[queue_index].tasks.push_back(std::move(task));
+    }
+    wake_up_.notify_one();
+}
+
+bool ThreadPool::TryRunTask(size_t queue_index) {
+    Task task;
+    {
+        WorkerQueue& own = queues_[queue_index];
+        std::lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t offset = 1; !task && offset < queues_.size(); ++offset) {
+        WorkerQueue& victim = queues_[(queue_index + offset) % queues_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued_task_count_.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::WorkerLoop(size_t queue_index) {
+    while (true) {
+        if (TryRunTask(queue_index)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_up_.wait(lock, [this]() {
+            return is_stopping_ || queued_task_count_.load(std::memory_order_relaxed) > 0;
+            });
+        if (is_stopping_) {
+            return;
+        }
+    }
+}
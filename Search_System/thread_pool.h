@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with a task deque each. A worker takes its own tasks from the back
+// and, once it runs out, steals from the front of the other deques, so a batch of tasks with very
+// different costs still keeps every thread busy. The thread that waits for a batch takes part in
+// it the same way.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    size_t GetThreadCount() const;
+
+    // Runs task(index) for every index in [0, count) and returns when all of them are done. If
+    // tasks throw, the remaining ones still run and the first exception is rethrown here.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    using Task = std::function<void()>;
+
+    // Queues are padded to a cache line so that neighbouring mutexes do not false-share.
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<WorkerQueue> queues_;
+
+    std::vector<std::thread> threads_;
+
+    std::mutex sleep_mutex_;
+
+    std::condition_variable wake_up_;
+
+    std::atomic<size_t> queued_task_count_{ 0 };
+
+    bool is_stopping_ = false;
+
+    void Push(size_t queue_index, Task task);
+
+    bool TryRunTask(size_t queue_index);
+
+    void WorkerLoop(size_t queue_index);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "document.h"
+
+const double RELEVANCE_EPSILON = 1e-6;
+
+// Relevances in the same RELEVANCE_EPSILON wide bucket are treated as equal and ordered by
+// rating, the document id breaks the remaining ties so that the order does not depend on the
+// input order. Comparing the difference of two relevances instead would not be transitive: a
+// chain of relevances each within the epsilon of the next would leave the heap and the sort
+// without a well-defined order.
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    const double lhs_bucket = std::floor(lhs.relevance / RELEVANCE_EPSILON);
+    const double rhs_bucket = std::floor(rhs.relevance / RELEVANCE_EPSILON);
+    if (lhs_bucket == rhs_bucket) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs_bucket > rhs_bucket;
+}
+
+// Keeps the count most relevant of the pushed documents in a bounded heap whose front is the
+// least relevant document kept so far.
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t count)
+        : count_(count) {
+        documents_.reserve(count);
+    }
+
+    void Push(const Document& document) {
+        if (documents_.size() < count_) {
+            documents_.push_back(document);
+            std::push_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+        }
+        else if (count_ > 0 && IsMoreRelevant(document, documents_.front())) {
+            std::pop_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+            documents_.back() = document;
+            std::push_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+        }
+    }
+
+    bool IsFull() const {
+        return documents_.size() == count_;
+    }
+
+    const Document& GetLeastRelevant() const {
+        return documents_.front();
+    }
+
+    std::vector<Document> Extract() {
+        std::sort_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+        return std::move(documents_);
+    }
+
+private:
+    size_t count_;
+    std::vector<Document> documents_;
+};
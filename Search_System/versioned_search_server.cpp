@@ -0,0 +1,86 @@
+#include "versioned_search_server.h"
+
+#include <atomic>
+#include <utility>
+
+VersionedSearchServer::VersionedSearchServer(SearchServer server)
+    : published_(std::make_shared<SearchServer>(server)), spare_(std::make_shared<SearchServer>(std::move(server)))
+    , spare_released_(std::make_shared<std::atomic<bool>>(true))
+{
+    published_released_ = Publish(published_);
+}
+
+std::shared_ptr<const SearchServer> VersionedSearchServer::GetSnapshot() const {
+    return std::atomic_load(&current_);
+}
+
+void VersionedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    ApplyUpdate([document_id, text = std::string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, text, status, ratings);
+        });
+}
+
+void VersionedSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    // The update outlives the caller's texts, so it keeps its own copies.
+    auto texts = std::make_shared<std::vector<std::string>>();
+    auto owned_documents = std::make_shared<std::vector<NewDocument>>(documents);
+    texts->reserve(documents.size());
+    for (NewDocument& document : *owned_documents) {
+        document.text = texts->emplace_back(document.text);
+    }
+    ApplyUpdate([texts, owned_documents](SearchServer& server) {
+        server.AddDocuments(*owned_documents);
+        });
+}
+
+void VersionedSearchServer::RemoveDocument(int document_id) {
+    ApplyUpdate([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+        });
+}
+
+void VersionedSearchServer::ApplyUpdate(Update update) {
+    std::lock_guard guard(write_mutex_);
+    std::shared_ptr<SearchServer> next = TakeWritableVersion();
+    try {
+        update(*next);
+    }
+    catch (...) {
+        // The update may have changed next before it threw, AddDocuments in REJECT mode inserts
+        // the new words of the batch into the dictionary before it finds a duplicate. next is
+        // dropped, so the next update starts from a copy of the published version.
+        throw;
+    }
+
+    std::shared_ptr<std::atomic<bool>> released = Publish(next);
+    spare_ = std::exchange(published_, std::move(next));
+    spare_released_ = std::exchange(published_released_, std::move(released));
+    spare_backlog_.push_back(std::move(update));
+}
+
+std::shared_ptr<std::atomic<bool>> VersionedSearchServer::Publish(const std::shared_ptr<SearchServer>& version) {
+    // Readers share one handle per publication. Its deleter runs after the last reader has released
+    // the handle, and the release store pairs with the acquire load in TakeWritableVersion.
+    auto released = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<const SearchServer> handle(version.get(), [version, released](const SearchServer*) {
+        released->store(true, std::memory_order_release);
+        });
+    std::atomic_store(&current_, std::move(handle));
+    return released;
+}
+
+std::shared_ptr<SearchServer> VersionedSearchServer::TakeWritableVersion() {
+    std::shared_ptr<SearchServer> version = std::move(spare_);
+    std::vector<Update> backlog = std::move(spare_backlog_);
+    spare_backlog_.clear();
+
+    // The spare version is no longer published, so once its last reader has released it nobody
+    // can acquire it again, and the reader's accesses happen before the modifications below.
+    if (version != nullptr && spare_released_->load(std::memory_order_acquire)) {
+        for (const Update& update : backlog) {
+            update(*version);
+        }
+        return version;
+    }
+    return std::make_shared<SearchServer>(*published_);
+}
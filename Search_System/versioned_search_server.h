@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Lets queries run concurrently with index updates. Readers take an immutable snapshot, a shared
+// pointer to a published SearchServer version, and query it without any locking. Writers are
+// serialized among themselves: every update is applied to a private version which is then
+// published with an atomic pointer swap, so readers are never blocked and never observe a
+// half-applied update.
+//
+// Two versions are kept. The one replaced by a publication is reused for the next update once no
+// reader holds it any more: it replays the updates it missed and receives the new one. If a reader
+// still holds it, it is released to the readers and the next version is copied from the current
+// one instead, so writers never wait for readers either. Snapshots should therefore be held only
+// for the duration of a query.
+class VersionedSearchServer {
+public:
+    using Update = std::function<void(SearchServer&)>;
+
+    explicit VersionedSearchServer(SearchServer server);
+
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    // Applies update to a new version and publishes it. The update is applied to both versions,
+    // so it must be deterministic. If it throws nothing is published and the version it was
+    // applied to is discarded, the next update copies the published version instead.
+    void ApplyUpdate(Update update);
+
+private:
+    std::mutex write_mutex_;
+
+    // Accessed only with std::atomic_load and std::atomic_store.
+    std::shared_ptr<const SearchServer> current_;
+
+    std::shared_ptr<SearchServer> published_;
+
+    std::shared_ptr<SearchServer> spare_;
+
+    // Set once no reader holds the corresponding version.
+    std::shared_ptr<std::atomic<bool>> published_released_;
+    std::shared_ptr<std::atomic<bool>> spare_released_;
+
+    // Updates that published_ has and spare_ has not received yet.
+    std::vector<Update> spare_backlog_;
+
+    std::shared_ptr<std::atomic<bool>> Publish(const std::shared_ptr<SearchServer>& version);
+
+    std::shared_ptr<SearchServer> TakeWritableVersion();
+};